@@ -1,34 +1,4842 @@
 // json_parser.cpp
-// Reads .json files in a directory and extracts `playlistName` and `shareCode`.
+// Reads .json files in one or more directories and extracts `playlistName` and `shareCode`.
 // Uses nlohmann::json when available, otherwise falls back to safe regex extraction.
+//
+// Extra build modes for checking the extraction backends against each other:
+//   -DJSON_PARSER_DIFFTEST   adds `--difftest`, a differential runner with a built-in random playlist generator
+//   -DJSON_PARSER_FUZZ       libFuzzer target instead of main() (clang++ -fsanitize=fuzzer,address -DJSON_PARSER_FUZZ)
 
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <regex>
 #include <sstream>
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <deque>
+#include <array>
+#include <memory>
+#include <cctype>
+#include <cerrno>
+#include <queue>
+#include <iterator>
+
+// Linux gets a raw getdents64 directory enumerator, directory-fd-relative file reads and
+// page-cache hints. Define JSON_PARSER_NO_GETDENTS / JSON_PARSER_NO_OPENAT /
+// JSON_PARSER_NO_FADVISE to compare against the portable versions.
+#if defined(__linux__)
+#  include <sched.h>
+#  include <dirent.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#  include <climits>
+#  if !defined(JSON_PARSER_NO_GETDENTS)
+#    define HAVE_GETDENTS64 1
+#  endif
+#  if !defined(JSON_PARSER_NO_OPENAT)
+#    define HAVE_OPENAT 1
+#  endif
+#  if !defined(JSON_PARSER_NO_FADVISE) && defined(HAVE_OPENAT)
+#    define HAVE_FADVISE 1
+#  endif
+#  define HAVE_WRITEV 1
+#endif
+
+#if defined(_WIN32)
+#  include <io.h>
+#  include <fcntl.h>
+#endif
 
 #if defined(__has_include)
 #  if __has_include(<nlohmann/json.hpp>)
 #    include <nlohmann/json.hpp>
 #    define HAVE_NLOHMANN_JSON 1
-#    using json = nlohmann::json;
 #  endif
 #endif
 
-namespace fs = std::filesystem;
+#if defined(HAVE_NLOHMANN_JSON)
+using json = nlohmann::json;
+#endif
+
+#if defined(JSON_PARSER_FUZZ)
+// libFuzzer supplies main(), which leaves the directory scanner itself unreferenced.
+#  pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+namespace fs = std::filesystem;
+
+// Taken during static initialization, so "time to first file" includes everything main() does first.
+static const auto processStart = std::chrono::steady_clock::now();
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct ScenarioEntry {
+    std::string name;
+    long long playCount = 0;
+};
+
+// Values of the --fields selection for one record, packed into one buffer: slot i is
+// bytes[ends[i - 1], ends[i]). One allocation per record however many fields are selected.
+struct FieldSlots {
+    std::string bytes;
+    std::vector<std::uint32_t> ends;
+
+    std::string_view value(std::size_t slot) const {
+        std::uint32_t begin = slot == 0 ? 0 : ends[slot - 1];
+        return std::string_view(bytes).substr(begin, ends[slot] - begin);
+    }
+};
+
+// Field names that do not come from the JSON document itself.
+static constexpr std::string_view kVirtualFileField = "@file";
+static constexpr std::string_view kVirtualScenarioCountField = "@scenarioCount";
+
+// One step of a compiled field path. Object keys are matched by length, then bytes; numeric
+// pointer tokens also match that array index.
+struct PathNode {
+    struct Child {
+        std::string key;
+        long long index = -1;
+        int node = 0;
+    };
+    std::vector<Child> children;
+    std::vector<int> slots;  // fields whose path ends here
+};
+
+// Splits a field name into path tokens: "name" is the top-level key, "/a/0/b" is a JSON Pointer
+// (RFC 6901, with ~1 for '/' and ~0 for '~').
+static std::vector<std::string> fieldPathTokens(const std::string& name) {
+    if (name.empty() || name[0] != '/') return {name};
+    std::vector<std::string> tokens;
+    std::string token;
+    for (std::size_t i = 1; i <= name.size(); ++i) {
+        if (i == name.size() || name[i] == '/') {
+            tokens.push_back(token);
+            token.clear();
+        } else if (name[i] == '~' && i + 1 < name.size() && (name[i + 1] == '0' || name[i + 1] == '1')) {
+            token += name[++i] == '0' ? '~' : '/';
+        } else {
+            token += name[i];
+        }
+    }
+    return tokens;
+}
+
+// The --fields selection, compiled once at startup. Slots [0, visibleCount) are written out in the
+// order the user gave; hidden slots after them carry fields the scanner itself needs.
+struct FieldTable {
+    std::vector<std::string> names;
+    std::size_t visibleCount = 0;
+    int playlistNameSlot = -1;
+    int shareCodeSlot = -1;
+    int authorNameSlot = -1;
+    int authorSteamIdSlot = -1;
+    int descriptionSlot = -1;
+    int fileSlot = -1;
+    int scenarioCountSlot = -1;
+    // Path trie; node 0 is the document root.
+    std::vector<PathNode> nodes{1};
+
+    static FieldTable compile(const std::vector<std::string>& requested, bool needDescription, bool needScenarioCount,
+                              bool needAuthor) {
+        FieldTable table;
+        auto slotOf = [&table](const std::string& name) {
+            for (std::size_t i = 0; i < table.names.size(); ++i) {
+                if (table.names[i] == name) return static_cast<int>(i);
+            }
+            table.names.push_back(name);
+            return static_cast<int>(table.names.size() - 1);
+        };
+        for (const auto& name : requested) slotOf(name);
+        table.visibleCount = table.names.size();
+        table.playlistNameSlot = slotOf("playlistName");
+        table.shareCodeSlot = slotOf("shareCode");
+        if (needDescription) table.descriptionSlot = slotOf("description");
+        if (needScenarioCount) slotOf(std::string(kVirtualScenarioCountField));
+        if (needAuthor) {
+            table.authorNameSlot = slotOf("authorName");
+            table.authorSteamIdSlot = slotOf("authorSteamId");
+        }
+
+        for (std::size_t i = 0; i < table.names.size(); ++i) {
+            const std::string& name = table.names[i];
+            int slot = static_cast<int>(i);
+            if (name == kVirtualFileField) {
+                table.fileSlot = slot;
+                continue;
+            }
+            if (name == kVirtualScenarioCountField) {
+                table.scenarioCountSlot = slot;
+                continue;
+            }
+            if (name == "authorName") table.authorNameSlot = slot;
+            if (name == "authorSteamId") table.authorSteamIdSlot = slot;
+            if (name == "description") table.descriptionSlot = slot;
+
+            int node = 0;
+            for (const auto& token : fieldPathTokens(name)) {
+                int next = table.child(node, token.data(), token.size());
+                if (next < 0) {
+                    PathNode::Child child;
+                    child.key = token;
+                    if (!token.empty() && token.size() < 18 &&
+                        token.find_first_not_of("0123456789") == std::string::npos &&
+                        (token.size() == 1 || token[0] != '0')) {
+                        child.index = std::stoll(token);
+                    }
+                    child.node = next = static_cast<int>(table.nodes.size());
+                    table.nodes.emplace_back();
+                    table.nodes[node].children.push_back(child);
+                }
+                node = next;
+            }
+            table.nodes[node].slots.push_back(slot);
+        }
+        return table;
+    }
+
+    int child(int node, const char* key, std::size_t length) const {
+        for (const auto& entry : nodes[node].children) {
+            if (entry.key.size() == length && std::memcmp(entry.key.data(), key, length) == 0) return entry.node;
+        }
+        return -1;
+    }
+
+    int childAt(int node, long long index) const {
+        for (const auto& entry : nodes[node].children) {
+            if (entry.index == index) return entry.node;
+        }
+        return -1;
+    }
+};
+
+// One step of a compiled --template: literal text, or the value in a --fields slot.
+struct TemplateOp {
+    std::string literal;
+    int slot = -1;
+};
+
+// Compiles "{shareCode}\t{playlistName}\n" into ops. Each placeholder becomes a field (added to
+// `fieldNames` on first use, so it goes through the same extraction as --fields); \n, \t, \r and
+// \\ are escapes and {{ / }} are literal braces. Returns false with `error` set on bad syntax.
+static bool compileTemplate(const std::string& text, std::vector<TemplateOp>& ops, std::vector<std::string>& fieldNames,
+                            std::string& error) {
+    std::string literal;
+    auto flushLiteral = [&] {
+        if (literal.empty()) return;
+        ops.push_back(TemplateOp{literal, -1});
+        literal.clear();
+    };
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < text.size()) {
+            char next = text[++i];
+            literal += next == 'n' ? '\n' : next == 't' ? '\t' : next == 'r' ? '\r' : next;
+        } else if ((c == '{' || c == '}') && i + 1 < text.size() && text[i + 1] == c) {
+            literal += c;
+            ++i;
+        } else if (c == '{') {
+            std::size_t close = text.find('}', i + 1);
+            if (close == std::string::npos) {
+                error = "unclosed '{' at position " + std::to_string(i);
+                return false;
+            }
+            std::string name = text.substr(i + 1, close - i - 1);
+            if (name.empty()) {
+                error = "empty placeholder at position " + std::to_string(i);
+                return false;
+            }
+            auto found = std::find(fieldNames.begin(), fieldNames.end(), name);
+            int slot = static_cast<int>(found - fieldNames.begin());
+            if (found == fieldNames.end()) fieldNames.push_back(name);
+            flushLiteral();
+            ops.push_back(TemplateOp{std::string(), slot});
+            i = close;
+        } else if (c == '}') {
+            error = "unmatched '}' at position " + std::to_string(i);
+            return false;
+        } else {
+            literal += c;
+        }
+    }
+    flushLiteral();
+    return true;
+}
+
+struct PartialFile;
+
+struct PlaylistData {
+    std::string playlistName;
+    std::string shareCode;
+    std::string authorName;
+    std::string authorSteamId;
+    std::string description;
+    std::vector<ScenarioEntry> scenarios;
+    std::vector<std::uint32_t> minHash;
+    FieldSlots fields;
+    int scenarioCount = 0;
+    std::int64_t modifiedTime = 0;
+    std::size_t rootIndex = 0;
+    bool rawStrings = true;  // top-level strings still carry JSON escapes; false once nlohmann decoded them
+    std::shared_ptr<PartialFile> partial;  // set instead of the fields while the file is still being written
+};
+
+// How --canonicalize picks the record kept for each share code. Ties keep the record seen first.
+enum class CanonicalPolicy {
+    Newest,
+    LongestDescription,
+    MostScenarios
+};
+
+struct ScanOptions {
+    bool includeAuthor = false;
+    bool includeDescription = false;
+    bool canonicalize = false;
+    CanonicalPolicy canonicalPolicy = CanonicalPolicy::Newest;
+    bool scenarioStats = false;
+    std::size_t topK = 20;
+    std::string similarTo;
+    bool skipStats = false;
+    int watchSeconds = 0;
+    bool directoryOrder = false;  // --dir-order: no inode sort or readahead, for cold-cache comparisons
+    std::size_t jobs = std::max(1u, std::thread::hardware_concurrency());  // reader + parser threads in total
+    bool pinThreads = false;  // --pin: one pipeline lane per NUMA node, workers pinned to its cores
+    std::size_t cacheBudgetBytes = 64u * 1024 * 1024;
+    std::vector<std::string> fieldNames;
+    FieldTable fieldTable;  // compiled from fieldNames; only used when fieldNames is non-empty
+    std::vector<TemplateOp> templateOps;  // --template; its placeholders are the fieldNames
+    std::string catalogDir;  // --catalog: also write a browsable catalog there
+    bool catalogMarkdown = false;
+    std::size_t catalogPageSize = 100;
+    std::string emitJsonDir;  // --emit-json: write one playlist .json per result there
+
+    // Shard files and --emit-json need each record's scenario list after the scan.
+    bool keepScenarios() const { return shardCount > 0 || !emitJsonDir.empty(); }
+    // --shard i/N: this process only scans files whose name hashes to shardIndex (0-based) and
+    // writes a binary shard file; canonicalization is left to the merge subcommand.
+    std::size_t shardIndex = 0;
+    std::size_t shardCount = 0;
+
+    bool sharded() const { return shardCount > 0; }
+};
+
+static bool isBetterCanonical(const PlaylistData& candidate, const PlaylistData& leader, CanonicalPolicy policy) {
+    switch (policy) {
+    case CanonicalPolicy::Newest:
+        return candidate.modifiedTime > leader.modifiedTime;
+    case CanonicalPolicy::LongestDescription:
+        return candidate.description.size() > leader.description.size();
+    case CanonicalPolicy::MostScenarios:
+        return candidate.scenarioCount > leader.scenarioCount;
+    }
+    return false;
+}
+
+// One leader per share code, updated in a single streaming pass. Leaders keep the
+// position of the first record seen for their group, so no sort is needed afterwards.
+struct CanonicalGroups {
+    CanonicalPolicy policy = CanonicalPolicy::Newest;
+    std::unordered_map<std::string, std::size_t> leaderIndex;
+    std::vector<PlaylistData> leaders;
+
+    void offer(PlaylistData&& data) {
+        auto found = leaderIndex.find(data.shareCode);
+        if (found == leaderIndex.end()) {
+            leaderIndex.emplace(data.shareCode, leaders.size());
+            leaders.push_back(std::move(data));
+        } else if (isBetterCanonical(data, leaders[found->second], policy)) {
+            leaders[found->second] = std::move(data);
+        }
+    }
+};
+
+// Playlists containing a scenario, and the sum of its play_Count across them.
+struct ScenarioTotals {
+    long long playlistCount = 0;
+    long long playCountSum = 0;
+};
+
+// One shard per scanner thread, so counting never takes a lock; shards are merged after the scan.
+using ScenarioCounts = std::unordered_map<std::string, ScenarioTotals>;
+
+static void countScenarios(const std::vector<ScenarioEntry>& scenarios, ScenarioCounts& counts) {
+    std::set<std::string> seenInPlaylist;
+    for (const auto& scenario : scenarios) {
+        ScenarioTotals& totals = counts[scenario.name];
+        totals.playCountSum += scenario.playCount;
+        if (seenInPlaylist.insert(scenario.name).second) {
+            ++totals.playlistCount;
+        }
+    }
+}
+
+// MinHash signatures of scenario sets, banded into an LSH index for --similar.
+// 16 bands of 4 rows put the 50% candidate threshold at a Jaccard similarity of about 0.5.
+constexpr std::size_t kMinHashSize = 64;
+constexpr std::size_t kLshBands = 16;
+constexpr std::size_t kLshRows = kMinHashSize / kLshBands;
+
+static std::uint64_t hashBytes(const std::string& text) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::uint64_t mix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static std::vector<std::uint32_t> computeMinHash(const std::vector<ScenarioEntry>& scenarios) {
+    std::vector<std::uint32_t> signature;
+    if (scenarios.empty()) return signature;
+    signature.assign(kMinHashSize, UINT32_MAX);
+    for (const auto& scenario : scenarios) {
+        std::uint64_t base = hashBytes(scenario.name);
+        for (std::size_t i = 0; i < kMinHashSize; ++i) {
+            auto value = static_cast<std::uint32_t>(mix64(base ^ (i * 0x2545f4914f6cdd1dull)));
+            signature[i] = std::min(signature[i], value);
+        }
+    }
+    return signature;
+}
+
+static double estimateJaccard(const std::vector<std::uint32_t>& a, const std::vector<std::uint32_t>& b) {
+    std::size_t equal = 0;
+    for (std::size_t i = 0; i < kMinHashSize; ++i) {
+        if (a[i] == b[i]) ++equal;
+    }
+    return static_cast<double>(equal) / kMinHashSize;
+}
+
+struct LshIndex {
+    std::vector<std::unordered_map<std::uint64_t, std::vector<std::size_t>>> buckets{kLshBands};
+
+    static std::uint64_t bandKey(const std::vector<std::uint32_t>& signature, std::size_t band) {
+        std::uint64_t key = band;
+        for (std::size_t row = 0; row < kLshRows; ++row) {
+            key = mix64(key ^ signature[band * kLshRows + row]);
+        }
+        return key;
+    }
+
+    void build(const std::vector<PlaylistData>& records) {
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            if (records[i].minHash.empty()) continue;
+            for (std::size_t band = 0; band < kLshBands; ++band) {
+                buckets[band][bandKey(records[i].minHash, band)].push_back(i);
+            }
+        }
+    }
+
+    std::vector<std::size_t> candidates(const std::vector<std::uint32_t>& signature) const {
+        std::vector<std::size_t> found;
+        for (std::size_t band = 0; band < kLshBands; ++band) {
+            auto bucket = buckets[band].find(bandKey(signature, band));
+            if (bucket != buckets[band].end()) {
+                found.insert(found.end(), bucket->second.begin(), bucket->second.end());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        return found;
+    }
+};
+
+// Identity of one version of a file. Size and mtime alone miss same-second rewrites by editors,
+// so the content hash decides; inode keeps two identical files in different places apart.
+struct FileStamp {
+    std::uint64_t inode = 0;
+    std::uint64_t size = 0;
+    std::int64_t modifiedTime = 0;
+};
+
+struct CacheKey {
+    FileStamp stamp;
+    std::uint64_t contentHash = 0;
+
+    bool operator==(const CacheKey& other) const {
+        return stamp.inode == other.stamp.inode && stamp.size == other.stamp.size &&
+               stamp.modifiedTime == other.stamp.modifiedTime && contentHash == other.contentHash;
+    }
+};
+
+struct CacheKeyHash {
+    std::size_t operator()(const CacheKey& key) const {
+        return static_cast<std::size_t>(mix64(key.contentHash ^ mix64(key.stamp.inode ^ mix64(key.stamp.size))));
+    }
+};
+
+// Eight bytes per step; only has to tell versions of the same file apart.
+static std::uint64_t hashContent(const std::string& content) {
+    std::uint64_t hash = content.size();
+    std::size_t pos = 0;
+    for (; pos + 8 <= content.size(); pos += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, content.data() + pos, 8);
+        hash = mix64(hash ^ word);
+    }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, content.data() + pos, content.size() - pos);
+    return mix64(hash ^ tail);
+}
+
+// Bounded LRU of parsed records for --watch, shared by all root scanners.
+struct ParseCache {
+    struct Entry {
+        CacheKey key;
+        PlaylistData data;
+        std::size_t bytes = 0;
+    };
+
+    std::mutex mutex;
+    std::size_t budgetBytes = 0;
+    std::size_t usedBytes = 0;
+    std::list<Entry> entries;  // most recently used first
+    std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> index;
+    long long hits = 0;
+    long long misses = 0;
+    long long evictions = 0;
+
+    static std::size_t footprint(const PlaylistData& data) {
+        std::size_t bytes = sizeof(Entry) + 4 * sizeof(void*) + data.playlistName.capacity() + data.shareCode.capacity() +
+                            data.authorName.capacity() + data.authorSteamId.capacity() + data.description.capacity() +
+                            data.scenarios.capacity() * sizeof(ScenarioEntry) + data.fields.bytes.capacity() +
+                            data.fields.ends.capacity() * sizeof(std::uint32_t);
+        for (const auto& scenario : data.scenarios) bytes += scenario.name.capacity();
+        return bytes;
+    }
+
+    bool lookup(const CacheKey& key, PlaylistData& data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found == index.end()) {
+            ++misses;
+            return false;
+        }
+        ++hits;
+        entries.splice(entries.begin(), entries, found->second);
+        data = found->second->data;
+        return true;
+    }
+
+    void insert(const CacheKey& key, const PlaylistData& data) {
+        std::size_t bytes = footprint(data);
+        if (bytes > budgetBytes) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key)) return;
+        entries.push_front(Entry{key, data, bytes});
+        index.emplace(key, entries.begin());
+        usedBytes += bytes;
+        while (usedBytes > budgetBytes) {
+            usedBytes -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+};
+
+// Per-root counters; duplicate share codes are attributed after the scan so the split is deterministic.
+struct RootStats {
+    std::string path;
+    int fileCount = 0;
+    int successfulParses = 0;
+    int failedParses = 0;
+    int deferredFiles = 0;     // caught mid-save and rechecked later
+    int deferredFinished = 0;  // of those, completed by a recheck
+    int stillWriting = 0;      // of those, still incomplete when the rechecks gave up
+    int deferredGone = 0;      // of those, deleted or renamed away before a recheck; not in fileCount
+    int duplicateShareCodes = 0;
+    double elapsedMs = 0.0;
+    double enumerateMs = 0.0;
+    double firstFileMs = -1.0;
+};
+
+static int highestBit(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+#endif
+}
+
+// Log-bucketed counts in the style of HDR histograms: values below 8 are exact, larger ones share
+// a bucket with everything within 1/8 of their octave, so quantiles are within 12.5%. Recording
+// is a bit scan and a few adds; histograms from different threads merge by adding counts.
+class LogHistogram {
+public:
+    void record(std::uint64_t value) {
+        ++counts_[bucketOf(value)];
+        ++count_;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LogHistogram& other) {
+        for (std::size_t i = 0; i < kBuckets; ++i) counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // Highest value in the bucket holding the q-quantile, clamped to the observed range.
+    std::uint64_t quantile(double q) const {
+        if (count_ == 0) return 0;
+        std::uint64_t rank = static_cast<std::uint64_t>(q * (count_ - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::max(min_, std::min(max_, bucketHigh(i)));
+        }
+        return max_;
+    }
+
+private:
+    static constexpr int kSubBits = 3;
+    static constexpr std::size_t kBuckets = static_cast<std::size_t>(64 - kSubBits + 1) << kSubBits;
+
+    static std::size_t bucketOf(std::uint64_t value) {
+        if (value < (1u << kSubBits)) return static_cast<std::size_t>(value);
+        int top = highestBit(value);
+        std::size_t sub = static_cast<std::size_t>(value >> (top - kSubBits)) & ((1u << kSubBits) - 1);
+        return (static_cast<std::size_t>(top - kSubBits + 1) << kSubBits) + sub;
+    }
+
+    static std::uint64_t bucketHigh(std::size_t bucket) {
+        if (bucket < (1u << kSubBits)) return bucket;
+        int top = static_cast<int>(bucket >> kSubBits) + kSubBits - 1;
+        std::uint64_t sub = bucket & ((1u << kSubBits) - 1);
+        std::uint64_t low = (std::uint64_t{1} << top) | (sub << (top - kSubBits));
+        return low + (std::uint64_t{1} << (top - kSubBits)) - 1;
+    }
+
+    std::array<std::uint64_t, kBuckets> counts_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t min_ = UINT64_MAX;
+    std::uint64_t max_ = 0;
+};
+
+// Shape of the scanned corpus, as recorded by one thread or merged from several.
+struct ScanHistograms {
+    LogHistogram fileBytes;
+    LogHistogram descriptionBytes;
+    LogHistogram scenarioCount;
+    LogHistogram parseNanos;
+
+    void merge(const ScanHistograms& other) {
+        fileBytes.merge(other.fileBytes);
+        descriptionBytes.merge(other.descriptionBytes);
+        scenarioCount.merge(other.scenarioCount);
+        parseNanos.merge(other.parseNanos);
+    }
+};
+
+// Every thread records into its own ScanHistograms, so recording takes no lock and no atomic;
+// collect() merges them. A thread's counts move into the retired total as the thread exits.
+class HistogramRegistry {
+public:
+    static ScanHistograms& local() {
+        thread_local Registration registration;
+        return registration.histograms;
+    }
+
+    // Everything recorded since the last collect(). Call it once the scan threads have finished.
+    static ScanHistograms collect() {
+        HistogramRegistry& registry = get();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        ScanHistograms total = registry.retired_;
+        registry.retired_ = ScanHistograms();
+        for (ScanHistograms* live : registry.live_) {
+            total.merge(*live);
+            *live = ScanHistograms();
+        }
+        return total;
+    }
+
+private:
+    struct Registration {
+        ScanHistograms histograms;
+
+        Registration() {
+            HistogramRegistry& registry = get();
+            std::lock_guard<std::mutex> lock(registry.mutex_);
+            registry.live_.push_back(&histograms);
+        }
+        ~Registration() {
+            HistogramRegistry& registry = get();
+            std::lock_guard<std::mutex> lock(registry.mutex_);
+            registry.retired_.merge(histograms);
+            registry.live_.erase(std::find(registry.live_.begin(), registry.live_.end(), &histograms));
+        }
+    };
+
+    static HistogramRegistry& get() {
+        static HistogramRegistry registry;
+        return registry;
+    }
+
+    std::mutex mutex_;
+    std::vector<ScanHistograms*> live_;
+    ScanHistograms retired_;
+};
+
+static void printHistograms(std::ostream& out, const ScanHistograms& histograms) {
+    auto line = [&out](const char* label, const LogHistogram& histogram, double scale) {
+        out << "  " << label << ": ";
+        if (histogram.count() == 0) {
+            out << "(no samples)" << '\n';
+            return;
+        }
+        out << "p50 " << histogram.quantile(0.5) / scale << ", p90 " << histogram.quantile(0.9) / scale << ", p99 "
+            << histogram.quantile(0.99) / scale << ", max " << histogram.max() / scale << ", mean "
+            << histogram.mean() / scale << " (n=" << histogram.count() << ")" << '\n';
+    };
+    out << "Corpus shape:" << '\n';
+    line("File size (bytes)", histograms.fileBytes, 1.0);
+    line("Description length (bytes, -d)", histograms.descriptionBytes, 1.0);
+    line("Scenarios per playlist", histograms.scenarioCount, 1.0);
+    line("Parse time (us)", histograms.parseNanos, 1000.0);
+}
+
+// ---- Tracing (--trace FILE) ----
+//
+// Spans are recorded per thread into fixed-size rings (once a ring is full the oldest spans are
+// overwritten) and written out as Chrome trace-event JSON for Perfetto or chrome://tracing.
+// While tracing is off a span is one untaken branch and no ring is ever allocated.
+
+static bool traceEnabled = false;
+
+struct TraceEvent {
+    const char* name;  // string literal
+    std::uint64_t startNs;
+    std::uint64_t durationNs;
+    std::uint64_t bytes;  // 0 when the span has no size
+};
+
+class TraceLog {
+public:
+    static constexpr std::size_t kRingEvents = 1 << 17;
+
+    static void record(const TraceEvent& event) { local().push(event); }
+    static void nameThread(const char* name) { local().name = name; }
+
+    // Writes everything recorded so far and starts over. Call it once the scan threads have finished.
+    static bool write(const std::string& path, std::size_t& events, std::uint64_t& dropped) {
+        TraceLog& log = get();
+        std::lock_guard<std::mutex> lock(log.mutex_);
+        std::vector<ThreadRing> threads = std::move(log.retired_);
+        log.retired_.clear();
+        for (ThreadRing* live : log.live_) {
+            threads.push_back(*live);
+            live->events.clear();
+            live->next = 0;
+            live->dropped = 0;
+        }
+
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        events = 0;
+        dropped = 0;
+        char line[256];
+        for (const auto& thread : threads) {
+            std::snprintf(line, sizeof(line),
+                          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}},\n",
+                          thread.tid, thread.name, thread.tid);
+            out += line;
+            for (const auto& event : thread.events) {
+                int length = std::snprintf(line, sizeof(line),
+                                           "{\"name\":\"%s\",\"cat\":\"scan\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                           "\"ts\":%.3f,\"dur\":%.3f",
+                                           event.name, thread.tid, event.startNs / 1000.0, event.durationNs / 1000.0);
+                out.append(line, static_cast<std::size_t>(length));
+                if (event.bytes) out += ",\"args\":{\"bytes\":" + std::to_string(event.bytes) + "}";
+                out += "},\n";
+            }
+            events += thread.events.size();
+            dropped += thread.dropped;
+        }
+        // A trailing comma is not allowed, so the list ends with one last metadata record.
+        out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"json_parser\"}}\n]}\n";
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        return file.is_open() && static_cast<bool>(file.write(out.data(), static_cast<std::streamsize>(out.size())));
+    }
+
+private:
+    struct ThreadRing {
+        std::uint32_t tid = 0;
+        const char* name = "worker";
+        std::vector<TraceEvent> events;
+        std::size_t next = 0;  // slot to overwrite once the ring is full
+        std::uint64_t dropped = 0;
+
+        void push(const TraceEvent& event) {
+            if (events.size() < kRingEvents) {
+                if (events.empty()) events.reserve(kRingEvents);
+                events.push_back(event);
+                return;
+            }
+            events[next] = event;
+            next = (next + 1) % kRingEvents;
+            ++dropped;
+        }
+    };
+
+    struct Registration {
+        ThreadRing ring;
+
+        Registration() {
+            TraceLog& log = get();
+            std::lock_guard<std::mutex> lock(log.mutex_);
+            ring.tid = ++log.nextTid_;
+            log.live_.push_back(&ring);
+        }
+        ~Registration() {
+            TraceLog& log = get();
+            std::lock_guard<std::mutex> lock(log.mutex_);
+            if (!ring.events.empty()) log.retired_.push_back(std::move(ring));
+            log.live_.erase(std::find(log.live_.begin(), log.live_.end(), &ring));
+        }
+    };
+
+    static ThreadRing& local() {
+        thread_local Registration registration;
+        return registration.ring;
+    }
+
+    static TraceLog& get() {
+        static TraceLog log;
+        return log;
+    }
+
+    std::mutex mutex_;
+    std::vector<ThreadRing*> live_;
+    std::vector<ThreadRing> retired_;
+    std::uint32_t nextTid_ = 0;
+};
+
+// Records the time from construction to end() (or destruction) as one span on this thread.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) {
+        if (!traceEnabled) return;
+        name_ = name;
+        startNs_ = nowNs();
+    }
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setBytes(std::uint64_t bytes) { bytes_ = bytes; }
+
+    void end() {
+        if (!name_) return;
+        TraceLog::record(TraceEvent{name_, startNs_, nowNs() - startNs_, bytes_});
+        name_ = nullptr;
+    }
+
+private:
+    static std::uint64_t nowNs() {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStart).count());
+    }
+
+    const char* name_ = nullptr;
+    std::uint64_t startNs_ = 0;
+    std::uint64_t bytes_ = 0;
+};
+
+static void nameTraceThread(const char* name) {
+    if (traceEnabled) TraceLog::nameThread(name);
+}
+
+// String-keyed hash map split into independently locked stripes picked by key hash, so threads
+// inserting different keys almost never wait on each other. Each update is atomic per key.
+template <typename Value>
+class StripedHashMap {
+public:
+    // Runs `update` on the key's value (default-constructed the first time the key is seen) while
+    // holding that key's stripe lock, and returns its result.
+    template <typename Update>
+    auto withValue(const std::string& key, Update update) {
+        Stripe& stripe = stripes_[mix64(hashBytes(key)) & (kStripes - 1)];
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        return update(stripe.entries[key]);
+    }
+
+    // Visits every entry, stripe by stripe. Not safe while other threads are still inserting.
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (const auto& stripe : stripes_) {
+            for (const auto& [key, value] : stripe.entries) visit(key, value);
+        }
+    }
+
+private:
+    static constexpr std::size_t kStripes = 64;
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+        std::unordered_map<std::string, Value> entries;
+    };
+    std::array<Stripe, kStripes> stripes_;
+};
+
+// Shared by every root scanner. Remembers which root each copy of a share code came from.
+struct DuplicateTracker {
+    StripedHashMap<std::vector<std::size_t>> shareCodeRoots;
+    StripedHashMap<int> playlistNameCopies;
+
+    // Returns true when the share code was already recorded from any root.
+    bool addShareCode(const std::string& shareCode, std::size_t rootIndex) {
+        return shareCodeRoots.withValue(shareCode, [rootIndex](std::vector<std::size_t>& roots) {
+            roots.push_back(rootIndex);
+            return roots.size() > 1;
+        });
+    }
+
+    // Returns true when the playlist name was already recorded from any root.
+    bool addPlaylistName(const std::string& playlistName) {
+        return playlistNameCopies.withValue(playlistName, [](int& copies) { return ++copies > 1; });
+    }
+};
+
+// Root scanners run concurrently; each per-file report is written in one piece under this lock.
+static std::mutex consoleMutex;
+// Per-file reports and duplicate warnings. --stdin moves them to stderr so stdout carries only results.
+static std::ostream* reportStream = &std::cout;
+
+// Reads whole files from one directory into a caller-owned buffer whose capacity is reused.
+// On Linux files are opened with openat on the bare name, so the kernel never re-walks the
+// directory path and no full path string is built per file.
+class DirectoryReader {
+public:
+    explicit DirectoryReader(const std::string& folderPath) : folderPath_(folderPath) {
+#if defined(HAVE_OPENAT)
+        dirFd_ = ::open(folderPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    }
+
+    ~DirectoryReader() {
+#if defined(HAVE_OPENAT)
+        if (dirFd_ >= 0) ::close(dirFd_);
+#endif
+    }
+
+    DirectoryReader(const DirectoryReader&) = delete;
+    DirectoryReader& operator=(const DirectoryReader&) = delete;
+
+    // Evict each file's pages once it has been read, so a huge scan does not push everything
+    // else out of the page cache. Only has an effect where posix_fadvise is available.
+    void setDropBehind(bool dropBehind) { dropBehind_ = dropBehind; }
+
+    // Replaces `content` with the file's bytes from `offset` on. When `stamp` is given it is filled
+    // in (its size is the whole file's); its mtime is only meaningful for comparison against other
+    // files read by the same build.
+    bool read(const std::string& name, std::string& content, FileStamp* stamp, std::uint64_t offset = 0) {
+        content.clear();
+#if defined(HAVE_OPENAT)
+        TraceSpan openSpan("open");
+        int fd = dirFd_ >= 0 ? ::openat(dirFd_, name.c_str(), O_RDONLY | O_CLOEXEC)
+                             : ::open(path(name).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        openSpan.end();
+        if (stamp) {
+            stamp->inode = static_cast<std::uint64_t>(info.st_ino);
+            stamp->size = static_cast<std::uint64_t>(info.st_size);
+            stamp->modifiedTime = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        }
+
+        TraceSpan readSpan("read");
+        std::uint64_t size = static_cast<std::uint64_t>(info.st_size);
+        content.resize(static_cast<std::size_t>(size > offset ? size - offset : 0));
+        std::size_t filled = 0;
+        while (filled < content.size()) {
+            ssize_t bytes = ::pread(fd, &content[filled], content.size() - filled, static_cast<off_t>(offset + filled));
+            if (bytes <= 0) break;
+            filled += static_cast<std::size_t>(bytes);
+        }
+        content.resize(filled);
+        readSpan.setBytes(filled);
+#if defined(HAVE_FADVISE)
+        if (dropBehind_) ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        ::close(fd);
+        return true;
+#else
+        std::string filepath = path(name);
+        TraceSpan openSpan("open");
+        std::ifstream ifs(filepath, std::ios::binary | std::ios::ate);
+        if (!ifs) return false;
+        openSpan.end();
+        TraceSpan readSpan("read");
+        std::uint64_t size = static_cast<std::uint64_t>(ifs.tellg());
+        std::uint64_t start = std::min(offset, size);
+        content.resize(static_cast<std::size_t>(size - start));
+        ifs.seekg(static_cast<std::streamoff>(start));
+        ifs.read(&content[0], static_cast<std::streamsize>(content.size()));
+        content.resize(static_cast<std::size_t>(ifs.gcount()));
+        readSpan.setBytes(content.size());
+        if (stamp) {
+            std::error_code ec;
+            stamp->size = size;
+            stamp->modifiedTime = static_cast<std::int64_t>(fs::last_write_time(filepath, ec).time_since_epoch().count());
+        }
+        return true;
+#endif
+    }
+
+    std::string path(const std::string& name) const {
+        return (fs::path(folderPath_) / name).string();
+    }
+
+    // True when the file was modified within `window` of now, i.e. a writer may still be busy with it.
+    bool recentlyModified(const std::string& name, std::chrono::milliseconds window) const {
+        std::error_code ec;
+        auto modified = fs::last_write_time(path(name), ec);
+        return !ec && fs::file_time_type::clock::now() - modified < window;
+    }
+
+private:
+    std::string folderPath_;
+    bool dropBehind_ = false;
+#if defined(HAVE_OPENAT)
+    int dirFd_ = -1;
+#endif
+};
+
+#if defined(HAVE_FADVISE)
+// Walks up to kWindow files ahead of the scanner, opening each one and asking the kernel to start
+// reading it (POSIX_FADV_WILLNEED). On a cold cache the inode and data reads then overlap with
+// parsing instead of stalling the scanner one file at a time; the window keeps the hints from
+// running so far ahead that they evict each other.
+class ReadaheadHinter {
+public:
+    static constexpr std::size_t kWindow = 64;
+
+    ReadaheadHinter(const std::string& folderPath, const std::vector<std::string>& names)
+        : names_(names), dirFd_(::open(folderPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) {
+        if (dirFd_ >= 0 && names_.size() > 1) thread_ = std::thread(&ReadaheadHinter::run, this);
+    }
+
+    ~ReadaheadHinter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        if (dirFd_ >= 0) ::close(dirFd_);
+    }
+
+    ReadaheadHinter(const ReadaheadHinter&) = delete;
+    ReadaheadHinter& operator=(const ReadaheadHinter&) = delete;
+
+    // The scanner has finished with names[0, count). Parallel readers may report out of order.
+    void consumed(std::size_t count) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            consumed_ = std::max(consumed_, count);
+        }
+        wake_.notify_one();
+    }
+
+private:
+    void run() {
+        for (std::size_t i = 0; i < names_.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || i < consumed_ + kWindow; });
+                if (stop_) return;
+                if (i < consumed_) continue;  // the scanner already got there
+            }
+            int fd = ::openat(dirFd_, names_[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+    }
+
+    const std::vector<std::string>& names_;
+    int dirFd_ = -1;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::size_t consumed_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+#endif
+
+// Minimal forward-only JSON scanning, used where only a few values are needed from a large document.
+// Strings are returned raw (escape sequences kept), the same way the regex fallback reports them.
+static void skipWhitespace(const std::string& text, std::size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+        ++pos;
+}
+
+static bool scanString(const std::string& text, std::size_t& pos, std::string* out) {
+    if (pos >= text.size() || text[pos] != '"') return false;
+    std::size_t start = ++pos;
+    while (pos < text.size() && text[pos] != '"') {
+        pos += (text[pos] == '\\') ? 2 : 1;
+    }
+    if (pos >= text.size()) return false;
+    if (out) out->assign(text, start, pos - start);
+    ++pos;
+    return true;
+}
+
+static bool skipValue(const std::string& text, std::size_t& pos) {
+    skipWhitespace(text, pos);
+    if (pos >= text.size()) return false;
+    if (text[pos] == '"') return scanString(text, pos, nullptr);
+    if (text[pos] == '{' || text[pos] == '[') {
+        int depth = 0;
+        while (pos < text.size()) {
+            char c = text[pos];
+            if (c == '"') {
+                if (!scanString(text, pos, nullptr)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') ++depth;
+            if (c == '}' || c == ']') --depth;
+            ++pos;
+            if (depth == 0) return true;
+        }
+        return false;
+    }
+    // A scalar must be at least one byte; "[1 }" would otherwise leave callers looping in place.
+    std::size_t start = pos;
+    while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']') ++pos;
+    return pos > start;
+}
+
+// Streaming path matcher for --fields. Only members and elements on a selected path are
+// descended into; every other subtree is skipped with skipValue, so no DOM is ever built.
+// The first value found for each slot wins: string contents raw (escapes kept), anything else
+// as its JSON text. Views point into `content`.
+struct FieldWalker {
+    const std::string& content;
+    const FieldTable& table;
+    std::vector<std::string_view>& values;
+    std::size_t pos = 0;
+    std::size_t remaining = 0;
+
+    static constexpr int kMaxDepth = 256;
+
+    bool walk(int node, int depth) {
+        skipWhitespace(content, pos);
+        if (pos >= content.size() || depth > kMaxDepth) return false;
+        const PathNode& current = table.nodes[node];
+        std::size_t valueStart = pos;
+        char open = content[pos];
+
+        if (current.children.empty() || (open != '{' && open != '[')) {
+            if (!skipValue(content, pos)) return false;
+        } else if (open == '{') {
+            if (!walkObject(node, depth)) return false;
+        } else if (!walkArray(node, depth)) {
+            return false;
+        }
+
+        if (!current.slots.empty()) record(current, valueStart);
+        return true;
+    }
+
+    bool walkObject(int node, int depth) {
+        ++pos;
+        while (remaining > 0) {
+            skipWhitespace(content, pos);
+            if (pos >= content.size()) return false;
+            if (content[pos] == '}') {
+                ++pos;
+                return true;
+            }
+            if (content[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            std::size_t keyStart = pos + 1;
+            if (!scanString(content, pos, nullptr)) return false;
+            int next = table.child(node, content.data() + keyStart, pos - 1 - keyStart);
+            skipWhitespace(content, pos);
+            if (pos >= content.size() || content[pos] != ':') return false;
+            ++pos;
+            if (next >= 0) {
+                if (!walk(next, depth + 1)) return false;
+            } else if (!skipValue(content, pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool walkArray(int node, int depth) {
+        ++pos;
+        long long index = 0;
+        while (remaining > 0) {
+            skipWhitespace(content, pos);
+            if (pos >= content.size()) return false;
+            if (content[pos] == ']') {
+                ++pos;
+                return true;
+            }
+            if (content[pos] == ',') {
+                ++pos;
+                ++index;
+                continue;
+            }
+            int next = table.childAt(node, index);
+            if (next >= 0) {
+                if (!walk(next, depth + 1)) return false;
+            } else if (!skipValue(content, pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void record(const PathNode& node, std::size_t valueStart) {
+        std::string_view value;
+        if (content[valueStart] == '"') {
+            value = std::string_view(content).substr(valueStart + 1, pos - valueStart - 2);
+        } else {
+            std::size_t valueEnd = pos;
+            while (valueEnd > valueStart && std::isspace(static_cast<unsigned char>(content[valueEnd - 1]))) --valueEnd;
+            value = std::string_view(content).substr(valueStart, valueEnd - valueStart);
+        }
+        for (int slot : node.slots) {
+            if (values[slot].data() == nullptr) {
+                values[slot] = value;
+                --remaining;
+            }
+        }
+    }
+};
+
+// Stops as soon as every selected path has a value.
+static bool extractFieldValues(const std::string& content, const FieldTable& table,
+                               std::vector<std::string_view>& values) {
+    values.assign(table.names.size(), std::string_view());
+    FieldWalker walker{content, table, values};
+    for (const auto& node : table.nodes) walker.remaining += node.slots.size();
+    return walker.walk(0, 0);
+}
+
+// Reads scenario_name / play_Count pairs from the top-level scenarioList array.
+// The key is found with the --fields walker, so a nested "scenarioList" or a string value that
+// happens to read "scenarioList" cannot be mistaken for it.
+static bool extractScenarios(const std::string& content, std::vector<ScenarioEntry>& scenarios) {
+    static const FieldTable table = FieldTable::compile({"scenarioList"}, false, false, false);
+    std::vector<std::string_view> values;
+    extractFieldValues(content, table, values);
+    if (values[0].empty() || values[0][0] != '[') return false;
+    std::size_t pos = static_cast<std::size_t>(values[0].data() - content.data()) + 1;
+
+    while (true) {
+        skipWhitespace(content, pos);
+        if (pos >= content.size()) return false;
+        if (content[pos] == ']') return true;
+        if (content[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (content[pos] != '{') return false;
+        ++pos;
+
+        ScenarioEntry entry;
+        while (true) {
+            skipWhitespace(content, pos);
+            if (pos >= content.size()) return false;
+            if (content[pos] == '}') {
+                ++pos;
+                break;
+            }
+            if (content[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            std::string key;
+            if (!scanString(content, pos, &key)) return false;
+            skipWhitespace(content, pos);
+            if (pos >= content.size() || content[pos] != ':') return false;
+            ++pos;
+            skipWhitespace(content, pos);
+            if (key == "scenario_name" && pos < content.size() && content[pos] == '"') {
+                if (!scanString(content, pos, &entry.name)) return false;
+            } else if (key == "play_Count") {
+                std::size_t end = pos;
+                if (!skipValue(content, end)) return false;
+                entry.playCount = std::atoll(content.c_str() + pos);
+                pos = end;
+            } else if (!skipValue(content, pos)) {
+                return false;
+            }
+        }
+        scenarios.push_back(std::move(entry));
+    }
+}
+
+static void packFieldSlots(const std::vector<std::string_view>& values, FieldSlots& slots) {
+    std::size_t total = 0;
+    for (auto value : values) total += value.size();
+    slots.bytes.clear();
+    slots.bytes.reserve(total);
+    slots.ends.clear();
+    slots.ends.reserve(values.size());
+    for (auto value : values) {
+        slots.bytes.append(value.data(), value.size());
+        slots.ends.push_back(static_cast<std::uint32_t>(slots.bytes.size()));
+    }
+}
+
+// Cuts a byte stream into JSON documents without parsing them. Feed it whatever each read
+// returned: the scan position, nesting depth and string/escape state carry over between feeds,
+// so a document split across reads is scanned once rather than from the start on every read.
+// Only the unfinished tail is buffered.
+class JsonStreamSplitter {
+public:
+    enum class Framing {
+        Auto,            // length-prefixed if the stream starts with a digit, otherwise Concatenated
+        Concatenated,    // objects/arrays back to back, any whitespace between (NDJSON included)
+        Lines,           // strict NDJSON: every non-blank line is one document
+        LengthPrefixed,  // "<decimal byte count>\n<document>", repeated
+    };
+
+    // Bigger documents are dropped (and counted as skipped bytes) instead of buffered.
+    static constexpr std::size_t kMaxDocumentBytes = 64u * 1024 * 1024;
+
+    explicit JsonStreamSplitter(Framing framing) : framing_(framing) {}
+
+    // Calls onDocument(std::string_view) for every document the new bytes complete.
+    template <typename OnDocument>
+    void feed(const char* data, std::size_t size, OnDocument onDocument) {
+        std::size_t offset = 0;
+        if (skipRemaining_ > 0) {
+            offset = std::min(size, skipRemaining_);
+            skipRemaining_ -= offset;
+            skippedBytes_ += offset;
+        }
+        buffer_.append(data + offset, size - offset);
+        std::size_t pos = scanned_;
+        while (pos < buffer_.size()) {
+            if (framing_ == Framing::Auto) {
+                unsigned char c = static_cast<unsigned char>(buffer_[pos]);
+                if (std::isspace(c)) {
+                    ++pos;
+                    continue;
+                }
+                framing_ = std::isdigit(c) ? Framing::LengthPrefixed : Framing::Concatenated;
+            }
+            if (framing_ == Framing::LengthPrefixed) {
+                if (!scanLengthPrefixed(pos, onDocument)) break;
+            } else if (framing_ == Framing::Lines) {
+                std::size_t newline = buffer_.find('\n', pos);
+                if (newline == std::string::npos) {
+                    pos = buffer_.size();
+                    break;
+                }
+                emitLine(newline, onDocument);
+                pos = start_ = newline + 1;
+            } else {
+                scanConcatenated(pos, onDocument);
+            }
+        }
+        scanned_ = pos;
+        if (buffer_.size() - start_ > kMaxDocumentBytes) {
+            skippedBytes_ += buffer_.size() - start_;
+            start_ = scanned_ = buffer_.size();
+            depth_ = 0;
+            inString_ = escaped_ = false;
+        }
+        // Drop everything already handed out; only the unfinished document stays buffered.
+        buffer_.erase(0, start_);
+        scanned_ -= start_;
+        start_ = 0;
+    }
+
+    // End of input. The last NDJSON line needs no trailing newline; in the other framings an
+    // unfinished document stays unfinished and is reported by pendingBytes().
+    template <typename OnDocument>
+    void finish(OnDocument onDocument) {
+        if (framing_ != Framing::Lines || skipRemaining_ > 0) return;
+        emitLine(buffer_.size(), onDocument);
+        buffer_.clear();
+        start_ = scanned_ = 0;
+    }
+
+    // Bytes left over at end of input that never formed a complete document.
+    std::size_t pendingBytes() const { return buffer_.size(); }
+    std::size_t skippedBytes() const { return skippedBytes_; }
+
+private:
+    template <typename OnDocument>
+    void emitLine(std::size_t end, OnDocument& onDocument) {
+        std::string_view line(buffer_.data() + start_, end - start_);
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) line.remove_suffix(1);
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front()))) line.remove_prefix(1);
+        if (!line.empty()) onDocument(line);
+    }
+
+    template <typename OnDocument>
+    void scanConcatenated(std::size_t& pos, OnDocument& onDocument) {
+        char c = buffer_[pos];
+        // Pretty-printers indent nested values and strings cannot hold a raw newline, so a '{' in
+        // the first column means the previous document was cut short: drop it and start over here.
+        if (depth_ > 0 && c == '{' && pos > 0 && buffer_[pos - 1] == '\n') {
+            skippedBytes_ += pos - start_;
+            depth_ = 0;
+            inString_ = escaped_ = false;
+        }
+        if (depth_ == 0) {
+            if (c == '{' || c == '[') {
+                depth_ = 1;
+                start_ = pos;
+            } else {
+                if (!std::isspace(static_cast<unsigned char>(c))) ++skippedBytes_;  // stray top-level byte
+                start_ = pos + 1;
+            }
+        } else if (inString_) {
+            if (escaped_) {
+                escaped_ = false;
+            } else if (c == '\\') {
+                escaped_ = true;
+            } else if (c == '"') {
+                inString_ = false;
+            }
+        } else if (c == '"') {
+            inString_ = true;
+        } else if (c == '{' || c == '[') {
+            ++depth_;
+        } else if ((c == '}' || c == ']') && --depth_ == 0) {
+            onDocument(std::string_view(buffer_.data() + start_, pos + 1 - start_));
+            start_ = pos + 1;
+        }
+        ++pos;
+    }
+
+    // Returns false when more input is needed.
+    template <typename OnDocument>
+    bool scanLengthPrefixed(std::size_t& pos, OnDocument& onDocument) {
+        if (expected_ == kNoLength) {
+            std::size_t newline = buffer_.find('\n', pos);
+            if (newline == std::string::npos) {
+                pos = buffer_.size();
+                return false;
+            }
+            std::string header = buffer_.substr(start_, newline - start_);
+            char* end = nullptr;
+            unsigned long long length = std::strtoull(header.c_str(), &end, 10);
+            bool valid = end != header.c_str() && std::all_of(static_cast<const char*>(end), header.c_str() + header.size(), [](char c) {
+                return std::isspace(static_cast<unsigned char>(c)) != 0;
+            });
+            pos = start_ = newline + 1;
+            if (!valid) {
+                skippedBytes_ += header.size() + 1;
+                return true;
+            }
+            if (length > kMaxDocumentBytes) {
+                std::size_t available = std::min<std::size_t>(length, buffer_.size() - start_);
+                skippedBytes_ += available;
+                skipRemaining_ = static_cast<std::size_t>(length) - available;
+                pos = start_ = start_ + available;
+                return true;
+            }
+            expected_ = static_cast<std::size_t>(length);
+        }
+        if (buffer_.size() - start_ < expected_) {
+            pos = buffer_.size();
+            return false;
+        }
+        onDocument(std::string_view(buffer_.data() + start_, expected_));
+        pos = start_ = start_ + expected_;
+        expected_ = kNoLength;
+        return true;
+    }
+
+    static constexpr std::size_t kNoLength = static_cast<std::size_t>(-1);
+
+    Framing framing_;
+    std::string buffer_;
+    std::size_t start_ = 0;    // first byte of the document being assembled
+    std::size_t scanned_ = 0;  // where the next feed resumes scanning
+    int depth_ = 0;
+    bool inString_ = false;
+    bool escaped_ = false;
+    std::size_t expected_ = kNoLength;
+    std::size_t skipRemaining_ = 0;
+    std::size_t skippedBytes_ = 0;
+};
+
+// A file seen mid-save. The splitter keeps its place, so a recheck feeds it only the bytes written
+// since; the last few bytes fed are kept to notice a file that was rewritten rather than appended to.
+struct PartialFile {
+    static constexpr std::size_t kTailBytes = 64;
+
+    JsonStreamSplitter splitter{JsonStreamSplitter::Framing::Concatenated};
+    std::uint64_t offset = 0;  // bytes of the file fed so far
+    std::string tail;
+    std::string document;      // the first complete document, once there is one
+    bool complete = false;
+
+    void feed(const char* data, std::size_t size) {
+        splitter.feed(data, size, [this](std::string_view found) {
+            if (complete) return;
+            document.assign(found.data(), found.size());
+            complete = true;
+        });
+        offset += size;
+        if (size >= kTailBytes) {
+            tail.assign(data + size - kTailBytes, kTailBytes);
+        } else {
+            tail.append(data, size);
+            if (tail.size() > kTailBytes) tail.erase(0, tail.size() - kTailBytes);
+        }
+    }
+
+    // An empty file, or an object or array that has not been closed yet.
+    bool unfinished() const { return !complete && (offset == 0 || splitter.pendingBytes() > 0); }
+};
+
+// Cheap first look: a finished playlist ends with its closing brace.
+static bool looksUnfinished(const std::string& content) {
+    std::size_t last = content.find_last_not_of(" \t\r\n");
+    return last == std::string::npos || (content[last] != '}' && content[last] != ']');
+}
+
+#if defined(HAVE_NLOHMANN_JSON)
+static void extractWithNlohmann(const std::string& content, bool includeAuthor, bool includeDescription,
+                                PlaylistData& data) {
+    try {
+        auto j = json::parse(content);
+        data.rawStrings = false;
+        if (j.contains("playlistName") && j["playlistName"].is_string())
+            data.playlistName = j["playlistName"].get<std::string>();
+        if (j.contains("shareCode") && j["shareCode"].is_string())
+            data.shareCode = j["shareCode"].get<std::string>();
+        if (includeAuthor) {
+            if (j.contains("authorName") && j["authorName"].is_string())
+                data.authorName = j["authorName"].get<std::string>();
+            if (j.contains("authorSteamId") && j["authorSteamId"].is_string())
+                data.authorSteamId = j["authorSteamId"].get<std::string>();
+        }
+        if (includeDescription) {
+            if (j.contains("description") && j["description"].is_string())
+                data.description = j["description"].get<std::string>();
+        }
+        if (j.contains("scenarioList") && j["scenarioList"].is_array())
+            data.scenarioCount = static_cast<int>(j["scenarioList"].size());
+    } catch (const std::exception&) {
+        // caller falls back to regex
+    }
+}
+#endif
+
+static void extractWithRegex(const std::string& content, bool includeAuthor, bool includeDescription,
+                             PlaylistData& data) {
+    // Compiled on first use only, so runs that never need the fallback never build them.
+    static const std::regex playlistPattern("\"playlistName\"\\s*:\\s*\"([^\"]*)\"");
+    static const std::regex shareCodePattern("\"shareCode\"\\s*:\\s*\"([^\"]*)\"");
+    std::smatch match;
+    if (std::regex_search(content, match, playlistPattern))
+        data.playlistName = match[1].str();
+    if (std::regex_search(content, match, shareCodePattern))
+        data.shareCode = match[1].str();
+    if (includeAuthor) {
+        static const std::regex authorNamePattern("\"authorName\"\\s*:\\s*\"([^\"]*)\"");
+        static const std::regex authorSteamIdPattern("\"authorSteamId\"\\s*:\\s*\"([^\"]*)\"");
+        if (std::regex_search(content, match, authorNamePattern))
+            data.authorName = match[1].str();
+        if (std::regex_search(content, match, authorSteamIdPattern))
+            data.authorSteamId = match[1].str();
+    }
+    if (includeDescription) {
+        static const std::regex descriptionPattern("\"description\"\\s*:\\s*\"([^\"]*)\"");
+        if (std::regex_search(content, match, descriptionPattern))
+            data.description = match[1].str();
+    }
+}
+
+static int countScenarioNames(const std::string& content) {
+    int count = 0;
+    for (std::size_t pos = content.find("\"scenario_name\""); pos != std::string::npos;
+         pos = content.find("\"scenario_name\"", pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+// --fields mode: one pass of the compiled key matcher replaces nlohmann and the regex fallback.
+static PlaylistData parseSelectedFields(const std::string& filename, const std::string& content, const FieldTable& table,
+                                        bool includeScenarios) {
+    PlaylistData data;
+    std::vector<std::string_view> values;
+    extractFieldValues(content, table, values);
+
+    auto assign = [&values](int slot, std::string& target) {
+        if (slot >= 0) target.assign(values[slot].data(), values[slot].size());
+    };
+    assign(table.playlistNameSlot, data.playlistName);
+    assign(table.shareCodeSlot, data.shareCode);
+    assign(table.authorNameSlot, data.authorName);
+    assign(table.authorSteamIdSlot, data.authorSteamId);
+    assign(table.descriptionSlot, data.description);
+
+    if (includeScenarios && extractScenarios(content, data.scenarios)) {
+        data.scenarioCount = static_cast<int>(data.scenarios.size());
+    }
+    std::string scenarioCountText;
+    if (table.scenarioCountSlot >= 0) {
+        if (data.scenarioCount == 0) data.scenarioCount = countScenarioNames(content);
+        scenarioCountText = std::to_string(data.scenarioCount);
+        values[table.scenarioCountSlot] = scenarioCountText;
+    }
+    if (table.fileSlot >= 0) values[table.fileSlot] = filename;
+    packFieldSlots(values, data.fields);
+
+    std::ostringstream report;
+    report << "File: " << filename << '\n';
+    for (std::size_t i = 0; i < table.visibleCount; ++i) {
+        std::string_view value = data.fields.value(i);
+        report << "  " << table.names[i] << ": " << (value.empty() ? std::string_view("(not found)") : value) << '\n';
+    }
+    std::lock_guard<std::mutex> lock(consoleMutex);
+    *reportStream << report.str();
+    return data;
+}
+
+static PlaylistData parseJsonFile(const DirectoryReader& reader, const std::string& filename, const std::string& content,
+                                  bool includeAuthor, bool includeDescription, bool includeScenarios,
+                                  const FieldTable* fields) {
+    PlaylistData data;
+    if (content.empty()) {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        std::cerr << "Failed to open or empty file: " << reader.path(filename) << std::endl;
+        return data;
+    }
+
+    if (fields) {
+        return parseSelectedFields(filename, content, *fields, includeScenarios);
+    }
+
+#if defined(HAVE_NLOHMANN_JSON)
+    extractWithNlohmann(content, includeAuthor, includeDescription, data);
+#endif
+
+    if (data.playlistName.empty() || data.shareCode.empty() ||
+        (includeAuthor && (data.authorName.empty() || data.authorSteamId.empty())) ||
+        (includeDescription && data.description.empty())) {
+        // The regex overwrites every string it matches with the raw text.
+        data.rawStrings = true;
+        extractWithRegex(content, includeAuthor, includeDescription, data);
+    }
+
+    if (includeScenarios && extractScenarios(content, data.scenarios)) {
+        data.scenarioCount = static_cast<int>(data.scenarios.size());
+    }
+
+    if (data.scenarioCount == 0) {
+        data.scenarioCount = countScenarioNames(content);
+    }
+
+    std::ostringstream report;
+    report << "File: " << filename << '\n';
+    report << "  playlistName: " << (data.playlistName.empty() ? "(not found)" : data.playlistName) << '\n';
+    report << "  shareCode: " << (data.shareCode.empty() ? "(not found)" : data.shareCode) << '\n';
+    if (includeAuthor) {
+        report << "  authorName: " << (data.authorName.empty() ? "(not found)" : data.authorName) << '\n';
+        report << "  authorSteamId: " << (data.authorSteamId.empty() ? "(not found)" : data.authorSteamId) << '\n';
+    }
+    if (includeDescription) {
+        report << "  description: " << (data.description.empty() ? "(not found)" : data.description) << '\n';
+    }
+
+    std::lock_guard<std::mutex> lock(consoleMutex);
+    *reportStream << report.str();
+
+    return data;
+}
+
+// Output labels with their lengths fixed at compile time, appended with a single memcpy each.
+struct Literal {
+    const char* text;
+    std::size_t size;
+};
+
+template <std::size_t N>
+constexpr Literal literal(const char (&text)[N]) {
+    return Literal{text, N - 1};
+}
+
+static constexpr Literal kPlaylistNameLabel = literal("Playlist Name: ");
+static constexpr Literal kShareCodeLabel = literal("Share Code: ");
+static constexpr Literal kAuthorLabel = literal("Author: ");
+static constexpr Literal kSteamIdLabel = literal(" SID: ");
+static constexpr Literal kDescriptionLabel = literal("Description: ");
+static constexpr Literal kNotFound = literal("(not found)");
+
+static void appendLiteral(std::string& out, Literal value) {
+    out.append(value.text, value.size);
+}
+
+static void appendFieldOrNotFound(std::string& out, const std::string& value) {
+    if (value.empty()) {
+        appendLiteral(out, kNotFound);
+    } else {
+        out.append(value);
+    }
+}
+
+// --fields layout: one "name: value" line per selected field, then a blank line.
+static void formatSelectedFields(const std::vector<PlaylistData>& results, std::size_t begin, std::size_t end,
+                                 const FieldTable& table, std::string& chunk) {
+    std::vector<std::string> labels;
+    for (std::size_t i = 0; i < table.visibleCount; ++i) labels.push_back(table.names[i] + ": ");
+
+    std::size_t bytes = 0;
+    for (std::size_t i = begin; i < end; ++i) bytes += 32 * table.visibleCount + results[i].fields.bytes.size();
+    chunk.clear();
+    chunk.reserve(bytes);
+
+    for (std::size_t i = begin; i < end; ++i) {
+        const FieldSlots& slots = results[i].fields;
+        for (std::size_t slot = 0; slot < table.visibleCount; ++slot) {
+            chunk.append(labels[slot]);
+            std::string_view value = slots.value(slot);
+            if (value.empty()) {
+                appendLiteral(chunk, kNotFound);
+            } else {
+                chunk.append(value.data(), value.size());
+            }
+            chunk += '\n';
+        }
+        chunk += '\n';
+    }
+}
+
+// Missing fields render as nothing, so templates can produce exact machine-readable lines.
+static void formatTemplate(const std::vector<PlaylistData>& results, std::size_t begin, std::size_t end,
+                           const std::vector<TemplateOp>& ops, std::string& chunk) {
+    std::size_t literalBytes = 0;
+    for (const auto& op : ops) literalBytes += op.literal.size();
+    std::size_t bytes = 0;
+    for (std::size_t i = begin; i < end; ++i) bytes += literalBytes + results[i].fields.bytes.size();
+    chunk.clear();
+    chunk.reserve(bytes);
+
+    for (std::size_t i = begin; i < end; ++i) {
+        const FieldSlots& slots = results[i].fields;
+        for (const auto& op : ops) {
+            if (op.slot < 0) {
+                chunk.append(op.literal);
+            } else {
+                std::string_view value = slots.value(static_cast<std::size_t>(op.slot));
+                chunk.append(value.data(), value.size());
+            }
+        }
+    }
+}
+
+// Same bytes as the old per-field ostream insertions, without locale or sentry work per field.
+static void formatResults(const std::vector<PlaylistData>& results, std::size_t begin, std::size_t end,
+                          const ScanOptions& options, std::string& chunk) {
+    TraceSpan span("format");
+    if (!options.templateOps.empty()) {
+        formatTemplate(results, begin, end, options.templateOps, chunk);
+        return;
+    }
+    if (!options.fieldNames.empty()) {
+        formatSelectedFields(results, begin, end, options.fieldTable, chunk);
+        return;
+    }
+    bool includeAuthor = options.includeAuthor;
+    bool includeDescription = options.includeDescription;
+
+    std::size_t bytes = 0;
+    for (std::size_t i = begin; i < end; ++i) {
+        const PlaylistData& result = results[i];
+        bytes += 64 + result.playlistName.size() + result.shareCode.size();
+        if (includeAuthor) bytes += result.authorName.size() + result.authorSteamId.size();
+        if (includeDescription) bytes += result.description.size();
+    }
+    chunk.clear();
+    chunk.reserve(bytes);
+
+    for (std::size_t i = begin; i < end; ++i) {
+        const PlaylistData& result = results[i];
+        appendLiteral(chunk, kPlaylistNameLabel);
+        appendFieldOrNotFound(chunk, result.playlistName);
+        chunk += '\n';
+        appendLiteral(chunk, kShareCodeLabel);
+        appendFieldOrNotFound(chunk, result.shareCode);
+        chunk += '\n';
+        if (includeAuthor && !result.authorName.empty() && !result.authorSteamId.empty()) {
+            appendLiteral(chunk, kAuthorLabel);
+            chunk.append(result.authorName);
+            appendLiteral(chunk, kSteamIdLabel);
+            chunk.append(result.authorSteamId);
+            chunk += '\n';
+        }
+        if (includeDescription && !result.description.empty()) {
+            appendLiteral(chunk, kDescriptionLabel);
+            chunk.append(result.description);
+            chunk += '\n';
+        }
+        chunk += '\n';
+    }
+}
+
+// Writes formatted chunks to a results file, in as many batches as the caller likes. On Linux each
+// batch is a handful of writev calls; elsewhere the text-mode stream keeps the platform's line
+// endings exactly as before. Failures are reported here, so a file that cannot be created is told
+// apart from one that could not be written (e.g. a full disk).
+class ResultFileWriter {
+public:
+    explicit ResultFileWriter(const std::string& path) : path_(path) {}
+
+    ~ResultFileWriter() {
+#if defined(HAVE_WRITEV)
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    ResultFileWriter(const ResultFileWriter&) = delete;
+    ResultFileWriter& operator=(const ResultFileWriter&) = delete;
+
+    bool open() {
+#if defined(HAVE_WRITEV)
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) return fail("open");
+#else
+        out_.open(path_);
+        if (!out_) return fail("open");
+#endif
+        return true;
+    }
+
+    bool write(const std::vector<std::string>& chunks) {
+        TraceSpan span("write");
+        std::uint64_t bytes = 0;
+        for (const auto& chunk : chunks) bytes += chunk.size();
+        span.setBytes(bytes);
+#if defined(HAVE_WRITEV)
+        std::vector<struct iovec> pending;
+        for (const auto& chunk : chunks) {
+            if (!chunk.empty()) pending.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+        }
+        std::size_t next = 0;
+        while (next < pending.size()) {
+            int count = static_cast<int>(std::min<std::size_t>(pending.size() - next, IOV_MAX));
+            ssize_t written = ::writev(fd_, &pending[next], count);
+            if (written < 0) return fail("write");
+            // Skip fully written buffers and trim a partially written one.
+            auto remaining = static_cast<std::size_t>(written);
+            while (next < pending.size() && remaining >= pending[next].iov_len) {
+                remaining -= pending[next].iov_len;
+                ++next;
+            }
+            if (remaining > 0) {
+                pending[next].iov_base = static_cast<char*>(pending[next].iov_base) + remaining;
+                pending[next].iov_len -= remaining;
+            }
+        }
+#else
+        for (const auto& chunk : chunks) {
+            out_.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        }
+        if (!out_) return fail("write");
+#endif
+        return true;
+    }
+
+    // Delayed write errors (NFS, quota) can surface only here.
+    bool close() {
+#if defined(HAVE_WRITEV)
+        int fd = fd_;
+        fd_ = -1;
+        if (::close(fd) != 0) return fail("write");
+#else
+        out_.close();
+        if (!out_) return fail("write");
+#endif
+        return true;
+    }
+
+private:
+    bool fail(const char* what) {
+        std::cerr << "Failed to " << what << " output file: " << path_;
+#if defined(HAVE_WRITEV)
+        std::cerr << " (" << std::strerror(errno) << ")";
+#endif
+        std::cerr << std::endl;
+        return false;
+    }
+
+    std::string path_;
+#if defined(HAVE_WRITEV)
+    int fd_ = -1;
+#else
+    std::ofstream out_;
+#endif
+};
+
+// Contiguous record ranges are formatted on up to `threads` threads; chunk order is record order,
+// so the chunks concatenate to byte-for-byte what a serial writer produces.
+static std::vector<std::string> formatChunks(const std::vector<PlaylistData>& results, const ScanOptions& options,
+                                             std::size_t threads) {
+    constexpr std::size_t kMinRecordsPerChunk = 4096;
+    std::size_t chunkCount = std::max<std::size_t>(1, std::min(threads, results.size() / kMinRecordsPerChunk));
+    std::vector<std::string> chunks(chunkCount);
+    std::size_t perChunk = (results.size() + chunkCount - 1) / chunkCount;
+
+    std::vector<std::thread> formatters;
+    for (std::size_t i = 1; i < chunkCount; ++i) {
+        std::size_t begin = std::min(results.size(), i * perChunk);
+        std::size_t end = std::min(results.size(), begin + perChunk);
+        formatters.emplace_back([&results, begin, end, &options, &chunk = chunks[i]] {
+            nameTraceThread("formatter");
+            formatResults(results, begin, end, options, chunk);
+        });
+    }
+    formatResults(results, 0, std::min(results.size(), perChunk), options, chunks[0]);
+    for (auto& formatter : formatters) {
+        formatter.join();
+    }
+    return chunks;
+}
+
+static void writeResultsToFile(const std::vector<PlaylistData>& results, const std::string& outputFile, const ScanOptions& options) {
+    std::vector<std::string> chunks = formatChunks(results, options, std::max(1u, std::thread::hardware_concurrency()));
+    ResultFileWriter writer(outputFile);
+    if (!writer.open() || !writer.write(chunks) || !writer.close()) return;
+
+    std::cout << "Results written to " << outputFile << '\n';
+}
+
+// ---- Catalog (--catalog DIR) ----
+//
+// index, one page per catalogPageSize playlists in alphabetical order, and an author index linking
+// back into the pages. Pages are independent, so they are rendered and written on all cores.
+
+static void appendHtmlEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '&': out.append("&amp;"); break;
+            case '<': out.append("&lt;"); break;
+            case '>': out.append("&gt;"); break;
+            case '"': out.append("&quot;"); break;
+            case '\'': out.append("&#39;"); break;
+            default: out += c;
+        }
+    }
+}
+
+// Keeps a value inside one Markdown table cell.
+static void appendMarkdownEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        if (c == '\n' || c == '\r') {
+            out += ' ';
+            continue;
+        }
+        if (std::strchr("\\`*_[]<>|#", c)) out += '\\';
+        out += c;
+    }
+}
+
+struct CatalogWriter {
+    const std::vector<PlaylistData>& results;
+    const ScanOptions& options;
+    fs::path directory;
+    std::vector<std::size_t> order;  // result indices, alphabetical by playlist name
+    std::size_t pageCount = 0;
+
+    const char* extension() const { return options.catalogMarkdown ? ".md" : ".html"; }
+
+    std::string pageName(std::size_t page) const {
+        std::string number = std::to_string(page + 1);
+        if (number.size() < 5) number.insert(0, 5 - number.size(), '0');
+        return "page-" + number + extension();
+    }
+
+    void escaped(std::string& out, std::string_view text) const {
+        if (options.catalogMarkdown) {
+            appendMarkdownEscaped(out, text);
+        } else {
+            appendHtmlEscaped(out, text);
+        }
+    }
+
+    void header(std::string& out, const std::string& title) const {
+        if (options.catalogMarkdown) {
+            out.append("# ");
+            escaped(out, title);
+            out.append("\n\n");
+        } else {
+            out.append("<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>");
+            escaped(out, title);
+            out.append("</title></head><body>\n<h1>");
+            escaped(out, title);
+            out.append("</h1>\n");
+        }
+    }
+
+    void footer(std::string& out) const {
+        if (!options.catalogMarkdown) out.append("</body></html>\n");
+    }
+
+    void link(std::string& out, const std::string& target, std::string_view text) const {
+        if (options.catalogMarkdown) {
+            out += '[';
+            escaped(out, text);
+            out.append("](").append(target).append(")");
+        } else {
+            out.append("<a href=\"").append(target).append("\">");
+            escaped(out, text);
+            out.append("</a>");
+        }
+    }
+
+    // Anchors are positions in `order`, so they stay unique even for duplicate share codes.
+    std::string anchor(std::size_t position) const { return "p" + std::to_string(position); }
+
+    std::string renderPage(std::size_t page) const {
+        std::size_t begin = page * options.catalogPageSize;
+        std::size_t end = std::min(order.size(), begin + options.catalogPageSize);
+        bool withDescription = options.includeDescription;
+        std::string out;
+        out.reserve((end - begin) * 160);
+        header(out, "Playlists - page " + std::to_string(page + 1) + " of " + std::to_string(pageCount));
+
+        if (options.catalogMarkdown) {
+            out.append("| Playlist | Share code | Author | Scenarios |");
+            out.append(withDescription ? " Description |\n|---|---|---|---|---|\n" : "\n|---|---|---|---|\n");
+        } else {
+            out.append("<table>\n<tr><th>Playlist</th><th>Share code</th><th>Author</th><th>Scenarios</th>");
+            out.append(withDescription ? "<th>Description</th></tr>\n" : "</tr>\n");
+        }
+        for (std::size_t position = begin; position < end; ++position) {
+            const PlaylistData& data = results[order[position]];
+            if (options.catalogMarkdown) {
+                out.append("| <a id=\"").append(anchor(position)).append("\"></a>");
+                escaped(out, data.playlistName);
+                out.append(" | ");
+                escaped(out, data.shareCode);
+                out.append(" | ");
+                escaped(out, data.authorName);
+                out.append(" | ").append(std::to_string(data.scenarioCount)).append(" |");
+                if (withDescription) {
+                    out += ' ';
+                    escaped(out, data.description);
+                    out.append(" |");
+                }
+                out += '\n';
+            } else {
+                out.append("<tr id=\"").append(anchor(position)).append("\"><td>");
+                escaped(out, data.playlistName);
+                out.append("</td><td>");
+                escaped(out, data.shareCode);
+                out.append("</td><td>");
+                escaped(out, data.authorName);
+                out.append("</td><td>").append(std::to_string(data.scenarioCount)).append("</td>");
+                if (withDescription) {
+                    out.append("<td>");
+                    escaped(out, data.description);
+                    out.append("</td>");
+                }
+                out.append("</tr>\n");
+            }
+        }
+        if (!options.catalogMarkdown) out.append("</table>\n");
+
+        out.append(options.catalogMarkdown ? "\n" : "<p>");
+        if (page > 0) {
+            link(out, pageName(page - 1), "previous");
+            out.append(" · ");
+        }
+        link(out, std::string("index") + extension(), "index");
+        if (page + 1 < pageCount) {
+            out.append(" · ");
+            link(out, pageName(page + 1), "next");
+        }
+        out.append(options.catalogMarkdown ? "\n" : "</p>\n");
+        footer(out);
+        return out;
+    }
+
+    std::string renderIndex() const {
+        std::string out;
+        header(out, "Playlist catalog");
+        out.append(options.catalogMarkdown ? "" : "<p>");
+        out.append(std::to_string(order.size())).append(" playlists. ");
+        link(out, std::string("authors") + extension(), "By author");
+        out.append(options.catalogMarkdown ? "\n\n" : "</p>\n<ul>\n");
+        for (std::size_t page = 0; page < pageCount; ++page) {
+            std::size_t first = page * options.catalogPageSize;
+            std::size_t last = std::min(order.size(), first + options.catalogPageSize) - 1;
+            std::string label = results[order[first]].playlistName + " - " + results[order[last]].playlistName;
+            out.append(options.catalogMarkdown ? "- " : "<li>");
+            link(out, pageName(page), label);
+            out.append(options.catalogMarkdown ? "\n" : "</li>\n");
+        }
+        if (!options.catalogMarkdown) out.append("</ul>\n");
+        footer(out);
+        return out;
+    }
+
+    std::string renderAuthors() const {
+        // Positions in `order` grouped by author; within an author they stay alphabetical.
+        std::map<std::string, std::vector<std::size_t>> byAuthor;
+        for (std::size_t position = 0; position < order.size(); ++position) {
+            const std::string& author = results[order[position]].authorName;
+            byAuthor[author.empty() ? std::string("(unknown author)") : author].push_back(position);
+        }
+        std::string out;
+        out.reserve(order.size() * 96);
+        header(out, "Playlists by author");
+        for (const auto& [author, positions] : byAuthor) {
+            if (options.catalogMarkdown) {
+                out.append("## ");
+                escaped(out, author);
+                out.append("\n\n");
+            } else {
+                out.append("<h2>");
+                escaped(out, author);
+                out.append("</h2>\n<ul>\n");
+            }
+            for (std::size_t position : positions) {
+                out.append(options.catalogMarkdown ? "- " : "<li>");
+                link(out, pageName(position / options.catalogPageSize) + "#" + anchor(position),
+                     results[order[position]].playlistName);
+                out.append(options.catalogMarkdown ? "\n" : "</li>\n");
+            }
+            out.append(options.catalogMarkdown ? "\n" : "</ul>\n");
+        }
+        footer(out);
+        return out;
+    }
+
+    bool writeFile(const std::string& name, const std::string& content) const {
+        TraceSpan span("write");
+        span.setBytes(content.size());
+        std::ofstream file(directory / name, std::ios::binary | std::ios::trunc);
+        return file.is_open() && static_cast<bool>(file.write(content.data(), static_cast<std::streamsize>(content.size())));
+    }
+};
+
+static void writeCatalog(const std::vector<PlaylistData>& results, const ScanOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    fs::create_directories(options.catalogDir, ec);
+    if (!fs::is_directory(options.catalogDir)) {
+        std::cerr << "Failed to create catalog directory: " << options.catalogDir << std::endl;
+        return;
+    }
+
+    CatalogWriter catalog{results, options, fs::path(options.catalogDir), {}, 0};
+    // Case-insensitive by name, then share code, so the order does not depend on scan order.
+    std::vector<std::string> keys(results.size());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        keys[i].reserve(results[i].playlistName.size());
+        for (unsigned char c : results[i].playlistName) keys[i] += static_cast<char>(std::tolower(c));
+        catalog.order.push_back(i);
+    }
+    std::sort(catalog.order.begin(), catalog.order.end(), [&](std::size_t a, std::size_t b) {
+        if (keys[a] != keys[b]) return keys[a] < keys[b];
+        return results[a].shareCode < results[b].shareCode;
+    });
+    catalog.pageCount = (results.size() + options.catalogPageSize - 1) / options.catalogPageSize;
+
+    std::atomic<std::size_t> nextPage{0};
+    std::atomic<bool> failed{false};
+    auto renderPages = [&] {
+        while (true) {
+            std::size_t page = nextPage.fetch_add(1);
+            if (page >= catalog.pageCount) break;
+            if (!catalog.writeFile(catalog.pageName(page), catalog.renderPage(page))) failed = true;
+        }
+    };
+    std::size_t threads = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), catalog.pageCount);
+    std::vector<std::thread> renderers;
+    for (std::size_t i = 1; i < threads; ++i) renderers.emplace_back(renderPages);
+    std::string index = catalog.renderIndex();
+    std::string authors = catalog.renderAuthors();
+    renderPages();
+    for (auto& renderer : renderers) renderer.join();
+
+    const char* extension = catalog.extension();
+    if (!catalog.writeFile(std::string("index") + extension, index) ||
+        !catalog.writeFile(std::string("authors") + extension, authors) || failed) {
+        std::cerr << "Failed to write catalog files in: " << options.catalogDir << std::endl;
+        return;
+    }
+    std::cout << "Catalog written to " << options.catalogDir << " (" << catalog.pageCount << " pages) in "
+              << millisecondsSince(start) << " ms" << '\n';
+}
+
+// ---- Playlist files (--emit-json DIR) ----
+//
+// Rebuilds a KovaaK's playlist file for every result, e.g. to restore a backup from shard files.
+// Only what the scan kept is written: name, share code, author, description and scenario list.
+
+// Values from the scanners and the regex fallback still carry their JSON escapes, while nlohmann
+// hands back decoded text (PlaylistData::rawStrings says which). In a raw value a backslash that
+// already starts a valid JSON escape is kept as is, so it comes back byte for byte; a decoded value
+// has every backslash escaped. Quotes and control bytes are always escaped.
+static void appendJsonString(std::string& out, std::string_view value, bool raw) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c == '\\' && raw) {
+            char next = i + 1 < value.size() ? value[i + 1] : '\0';
+            bool escape = next != '\0' && std::strchr("\"\\/bfnrt", next) != nullptr;
+            if (next == 'u' && i + 5 < value.size()) {
+                escape = std::all_of(value.begin() + i + 2, value.begin() + i + 6,
+                                     [](char h) { return std::isxdigit(static_cast<unsigned char>(h)) != 0; });
+            }
+            if (escape) {
+                out += '\\';
+                out += value[++i];
+            } else {
+                out.append("\\\\");
+            }
+        } else if (c == '\\') {
+            out.append("\\\\");
+        } else if (c == '"') {
+            out.append("\\\"");
+        } else if (c < 0x20) {
+            out.append("\\u00");
+            out += kHex[c >> 4];
+            out += kHex[c & 15];
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+static void renderPlaylistJson(const PlaylistData& data, std::string& out) {
+    out.clear();
+    out.append("{\n  \"playlistName\": ");
+    appendJsonString(out, data.playlistName, data.rawStrings);
+    out.append(",\n  \"authorSteamId\": ");
+    appendJsonString(out, data.authorSteamId, data.rawStrings);
+    out.append(",\n  \"authorName\": ");
+    appendJsonString(out, data.authorName, data.rawStrings);
+    out.append(",\n  \"scenarioList\": [");
+    for (std::size_t i = 0; i < data.scenarios.size(); ++i) {
+        out.append(i == 0 ? "\n    {\n      \"scenario_name\": " : ",\n    {\n      \"scenario_name\": ");
+        appendJsonString(out, data.scenarios[i].name, true);
+        out.append(",\n      \"play_Count\": ").append(std::to_string(data.scenarios[i].playCount)).append("\n    }");
+    }
+    out.append(data.scenarios.empty() ? "],\n  \"description\": " : "\n  ],\n  \"description\": ");
+    appendJsonString(out, data.description, data.rawStrings);
+    out.append(",\n  \"hasOfflineScenarios\": false,\n  \"hasEdited\": false,\n  \"shareCode\": ");
+    appendJsonString(out, data.shareCode, data.rawStrings);
+    out.append("\n}");
+}
+
+// "<share code>.json" with anything outside [A-Za-z0-9 _.-] replaced; repeats get "-2", "-3", ...
+static std::vector<std::string> playlistFileNames(const std::vector<PlaylistData>& results) {
+    std::vector<std::string> names;
+    names.reserve(results.size());
+    std::unordered_map<std::string, int> uses;
+    for (const auto& data : results) {
+        std::string stem;
+        for (unsigned char c : data.shareCode) {
+            stem += (std::isalnum(c) || c == ' ' || c == '_' || c == '.' || c == '-') ? static_cast<char>(c) : '_';
+        }
+        if (stem.empty() || stem[0] == '.') stem.insert(0, "playlist");
+        int copy = ++uses[stem];
+        names.push_back(copy == 1 ? stem + ".json" : stem + "-" + std::to_string(copy) + ".json");
+    }
+    return names;
+}
+
+// Workers take contiguous batches of records; on Linux each batch is created relative to one
+// directory fd, so there is no path lookup per file.
+static void emitPlaylistFiles(const std::vector<PlaylistData>& results, const ScanOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    fs::create_directories(options.emitJsonDir, ec);
+    if (!fs::is_directory(options.emitJsonDir)) {
+        std::cerr << "Failed to create directory: " << options.emitJsonDir << std::endl;
+        return;
+    }
+    std::vector<std::string> names = playlistFileNames(results);
+
+    constexpr std::size_t kBatch = 256;
+    std::atomic<std::size_t> nextBatch{0};
+    std::atomic<std::size_t> failures{0};
+    auto emitBatches = [&] {
+#if defined(HAVE_OPENAT)
+        int dirFd = ::open(options.emitJsonDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+        std::string content;
+        while (true) {
+            std::size_t begin = nextBatch.fetch_add(1) * kBatch;
+            if (begin >= results.size()) break;
+            std::size_t end = std::min(results.size(), begin + kBatch);
+            for (std::size_t i = begin; i < end; ++i) {
+                renderPlaylistJson(results[i], content);
+                TraceSpan span("write");
+                span.setBytes(content.size());
+                bool written = false;
+#if defined(HAVE_OPENAT)
+                int fd = ::openat(dirFd, names[i].c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd >= 0) {
+                    written = ::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+                    written = ::close(fd) == 0 && written;
+                }
+#else
+                std::ofstream file(fs::path(options.emitJsonDir) / names[i], std::ios::binary | std::ios::trunc);
+                written = file.is_open() &&
+                          static_cast<bool>(file.write(content.data(), static_cast<std::streamsize>(content.size())));
+#endif
+                if (!written) failures.fetch_add(1);
+            }
+        }
+#if defined(HAVE_OPENAT)
+        if (dirFd >= 0) ::close(dirFd);
+#endif
+    };
+
+    std::size_t threads = std::max<std::size_t>(1, std::min<std::size_t>(options.jobs, (results.size() + kBatch - 1) / kBatch));
+    std::vector<std::thread> emitters;
+    for (std::size_t i = 1; i < threads; ++i) emitters.emplace_back(emitBatches);
+    emitBatches();
+    for (auto& emitter : emitters) emitter.join();
+
+    double ms = millisecondsSince(start);
+    if (failures > 0) {
+        std::cerr << "Failed to write " << failures.load() << " playlist files in: " << options.emitJsonDir << std::endl;
+    }
+    std::cout << "Emitted " << (results.size() - failures.load()) << " playlist files to " << options.emitJsonDir << " in "
+              << ms << " ms";
+    if (ms > 0.0) std::cout << " (" << static_cast<long long>(results.size() / (ms / 1000.0)) << " files/sec)";
+    std::cout << '\n';
+}
+
+// ---- Shard files (--shard i/N and the merge subcommand) ----
+//
+// A shard file is a header, the shard's records (with their scenario lists) sorted by share code,
+// then its playlist names sorted with their copy counts. Both sections are sorted so merging N shards is one k-way pass
+// that also yields exact global duplicate counts. Integers are fixed-width little-endian;
+// strings are a u32 length followed by the bytes.
+static constexpr char kShardMagic[8] = {'P', 'J', 'S', 'H', 'A', 'R', 'D', '3'};
+
+struct ShardHeader {
+    std::uint32_t shardIndex = 0;
+    std::uint32_t shardCount = 0;
+    std::uint64_t fileCount = 0;
+    std::uint64_t successfulParses = 0;
+    std::uint64_t failedParses = 0;
+    std::uint64_t recordCount = 0;
+    std::uint64_t nameCount = 0;
+    std::vector<std::string> fieldNames;
+};
+
+// Files are assigned by name only, so every machine agrees whatever the mount point of the root.
+static bool inShard(const std::string& name, const ScanOptions& options) {
+    return mix64(hashBytes(name)) % options.shardCount == options.shardIndex;
+}
+
+static void putU32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+static void putU64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+static void putString(std::string& out, std::string_view value) {
+    putU32(out, static_cast<std::uint32_t>(value.size()));
+    out.append(value.data(), value.size());
+}
+
+// Sorts `results` by share code (stable, so scan order breaks ties) and writes the shard file.
+static bool writeShardFile(std::vector<PlaylistData>& results, const std::string& shardFile, const ScanOptions& options,
+                           int fileCount, int successfulParses, int failedParses) {
+    auto start = std::chrono::steady_clock::now();
+    std::stable_sort(results.begin(), results.end(), [](const PlaylistData& a, const PlaylistData& b) {
+        return a.shareCode < b.shareCode;
+    });
+    std::vector<std::string_view> names;
+    names.reserve(results.size());
+    for (const auto& result : results) names.push_back(result.playlistName);
+    std::sort(names.begin(), names.end());
+    std::vector<std::pair<std::string_view, std::uint64_t>> nameCopies;
+    for (std::string_view name : names) {
+        if (nameCopies.empty() || nameCopies.back().first != name) nameCopies.emplace_back(name, 0);
+        ++nameCopies.back().second;
+    }
+
+    std::string out(kShardMagic, sizeof(kShardMagic));
+    putU32(out, static_cast<std::uint32_t>(options.shardIndex));
+    putU32(out, static_cast<std::uint32_t>(options.shardCount));
+    putU64(out, static_cast<std::uint64_t>(fileCount));
+    putU64(out, static_cast<std::uint64_t>(successfulParses));
+    putU64(out, static_cast<std::uint64_t>(failedParses));
+    putU64(out, results.size());
+    putU64(out, nameCopies.size());
+    putU32(out, static_cast<std::uint32_t>(options.fieldNames.size()));
+    for (const auto& name : options.fieldNames) putString(out, name);
+
+    for (const auto& result : results) {
+        putString(out, result.shareCode);
+        putString(out, result.playlistName);
+        putString(out, result.authorName);
+        putString(out, result.authorSteamId);
+        putString(out, result.description);
+        putString(out, result.fields.bytes);
+        putU32(out, static_cast<std::uint32_t>(result.fields.ends.size()));
+        for (std::uint32_t end : result.fields.ends) putU32(out, end);
+        putU32(out, static_cast<std::uint32_t>(result.scenarioCount));
+        putU64(out, static_cast<std::uint64_t>(result.modifiedTime));
+        putU32(out, result.rawStrings ? 1u : 0u);
+        putU32(out, static_cast<std::uint32_t>(result.scenarios.size()));
+        for (const auto& scenario : result.scenarios) {
+            putString(out, scenario.name);
+            putU64(out, static_cast<std::uint64_t>(scenario.playCount));
+        }
+    }
+    for (const auto& [name, copies] : nameCopies) {
+        putString(out, name);
+        putU64(out, copies);
+    }
+
+    TraceSpan span("write");
+    span.setBytes(out.size());
+    std::ofstream file(shardFile, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() || !file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+        std::cerr << "Failed to write shard file: " << shardFile << std::endl;
+        return false;
+    }
+    std::cout << "Shard " << (options.shardIndex + 1) << "/" << options.shardCount << " written to " << shardFile
+              << " (" << results.size() << " records, " << out.size() / 1024 << " KiB) in "
+              << millisecondsSince(start) << " ms" << '\n';
+    return true;
+}
+
+// Streams one shard file: the header, then records in order, then playlist names in order.
+class ShardReader {
+public:
+    explicit ShardReader(const std::string& path) : in_(path, std::ios::binary) {
+        // Every count in the file is checked against the bytes left before anything is allocated
+        // for it, so a corrupt length reads as a bad file rather than a huge allocation.
+        if (in_.seekg(0, std::ios::end)) {
+            bytesLeft_ = static_cast<std::uint64_t>(in_.tellg());
+            in_.seekg(0, std::ios::beg);
+        }
+    }
+
+    bool readHeader(ShardHeader& header) {
+        char magic[sizeof(kShardMagic)];
+        if (!getBytes(magic, sizeof(magic)) || std::memcmp(magic, kShardMagic, sizeof(magic)) != 0) return false;
+        std::uint32_t fieldCount = 0;
+        if (!getU32(header.shardIndex) || !getU32(header.shardCount) || !getU64(header.fileCount) ||
+            !getU64(header.successfulParses) || !getU64(header.failedParses) || !getU64(header.recordCount) ||
+            !getU64(header.nameCount) || !getU32(fieldCount) || !fits(fieldCount, 4)) {
+            return false;
+        }
+        header.fieldNames.resize(fieldCount);
+        for (auto& name : header.fieldNames) {
+            if (!getString(name)) return false;
+        }
+        recordsLeft_ = header.recordCount;
+        namesLeft_ = header.nameCount;
+        return header.shardCount > 0 && header.shardIndex < header.shardCount;
+    }
+
+    // False at the end of the record section; check failed() to tell that apart from a bad file.
+    bool nextRecord(PlaylistData& data) {
+        if (recordsLeft_ == 0) return false;
+        --recordsLeft_;
+        std::uint32_t endCount = 0;
+        std::uint32_t scenarioCount = 0;
+        std::uint64_t modifiedTime = 0;
+        bool ok = getString(data.shareCode) && getString(data.playlistName) && getString(data.authorName) &&
+                  getString(data.authorSteamId) && getString(data.description) && getString(data.fields.bytes) &&
+                  getU32(endCount) && fits(endCount, 4);
+        data.fields.ends.resize(ok ? endCount : 0);
+        for (auto& end : data.fields.ends) ok = ok && getU32(end);
+        std::uint32_t rawStrings = 0;
+        std::uint32_t scenarioListSize = 0;
+        ok = ok && getU32(scenarioCount) && getU64(modifiedTime) && getU32(rawStrings) && getU32(scenarioListSize) &&
+             fits(scenarioListSize, 12);
+        data.rawStrings = rawStrings != 0;
+        data.scenarioCount = static_cast<int>(scenarioCount);
+        data.modifiedTime = static_cast<std::int64_t>(modifiedTime);
+        data.scenarios.resize(ok ? scenarioListSize : 0);
+        for (auto& scenario : data.scenarios) {
+            std::uint64_t playCount = 0;
+            ok = ok && getString(scenario.name) && getU64(playCount);
+            scenario.playCount = static_cast<long long>(playCount);
+        }
+        return ok || fail();
+    }
+
+    // Only valid once every record has been read.
+    bool nextName(std::string& name, std::uint64_t& copies) {
+        if (namesLeft_ == 0 || recordsLeft_ != 0) return false;
+        --namesLeft_;
+        return (getString(name) && getU64(copies)) || fail();
+    }
+
+    bool failed() const { return failed_; }
+
+private:
+    bool fail() {
+        failed_ = true;
+        recordsLeft_ = namesLeft_ = 0;
+        return false;
+    }
+
+    // True when `count` items of at least `itemBytes` each could still follow.
+    bool fits(std::uint64_t count, std::uint64_t itemBytes) const { return count <= bytesLeft_ / itemBytes; }
+
+    bool getBytes(char* out, std::size_t length) {
+        if (length > bytesLeft_ || !in_.read(out, static_cast<std::streamsize>(length))) return false;
+        bytesLeft_ -= length;
+        return true;
+    }
+
+    bool getU32(std::uint32_t& value) {
+        unsigned char bytes[4];
+        if (!getBytes(reinterpret_cast<char*>(bytes), sizeof(bytes))) return false;
+        value = 0;
+        for (int i = 3; i >= 0; --i) value = (value << 8) | bytes[i];
+        return true;
+    }
+
+    bool getU64(std::uint64_t& value) {
+        unsigned char bytes[8];
+        if (!getBytes(reinterpret_cast<char*>(bytes), sizeof(bytes))) return false;
+        value = 0;
+        for (int i = 7; i >= 0; --i) value = (value << 8) | bytes[i];
+        return true;
+    }
+
+    bool getString(std::string& value) {
+        std::uint32_t length = 0;
+        if (!getU32(length) || !fits(length, 1)) return false;
+        value.resize(length);
+        return length == 0 || getBytes(&value[0], length);
+    }
+
+    std::ifstream in_;
+    std::uint64_t bytesLeft_ = 0;
+    std::uint64_t recordsLeft_ = 0;
+    std::uint64_t namesLeft_ = 0;
+    bool failed_ = false;
+};
+
+// Bounded lock-free multi-producer/multi-consumer ring (Vyukov's sequence-numbered cells).
+// Each cell's sequence number says whether it is free for the producer at that position or holds
+// a value for the consumer there, so producers and consumers only contend on their own position
+// counter. tryDequeueBatch claims a run of ready cells with a single CAS.
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(std::size_t minCapacity) {
+        std::size_t capacity = 2;
+        while (capacity < minCapacity) capacity *= 2;
+        cells_ = std::make_unique<Cell[]>(capacity);
+        mask_ = capacity - 1;
+        for (std::size_t i = 0; i < capacity; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // False when the ring is full.
+    bool tryEnqueue(const T& value) {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Moves up to maxItems values into `out` in FIFO order; returns how many (0 when empty).
+    std::size_t tryDequeueBatch(T* out, std::size_t maxItems) {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        while (true) {
+            std::size_t ready = 0;
+            while (ready < maxItems &&
+                   cells_[(pos + ready) & mask_].sequence.load(std::memory_order_acquire) == pos + ready + 1) {
+                ++ready;
+            }
+            if (ready == 0) {
+                std::size_t sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+                if (static_cast<std::ptrdiff_t>(sequence - (pos + 1)) < 0) return 0;
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (dequeuePos_.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                for (std::size_t i = 0; i < ready; ++i) {
+                    Cell& cell = cells_[(pos + i) & mask_];
+                    out[i] = std::move(cell.value);
+                    cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_ = 0;
+    alignas(64) std::atomic<std::size_t> enqueuePos_{0};
+    alignas(64) std::atomic<std::size_t> dequeuePos_{0};
+};
+
+using ParseFileFn = std::function<PlaylistData(const std::string& name, const std::string& content, const FileStamp& stamp)>;
+using ParsedFn = std::function<void(std::size_t index, PlaylistData& data)>;
+
+// CPUs this process may run on, grouped by NUMA node. Read from sysfs on Linux and cut down to the
+// affinity mask the process started with (taskset, cgroups); elsewhere, or if sysfs is missing, it
+// is one node holding every allowed hardware thread. Nodes left with no allowed CPU are dropped.
+struct CpuTopology {
+    std::vector<std::vector<int>> nodeCpus;
+
+    static const CpuTopology& get() {
+        static const CpuTopology topology = detect();
+        return topology;
+    }
+
+private:
+    static CpuTopology detect() {
+        CpuTopology topology;
+#if defined(__linux__)
+        cpu_set_t allowedSet;
+        CPU_ZERO(&allowedSet);
+        bool haveMask = ::sched_getaffinity(0, sizeof(allowedSet), &allowedSet) == 0;
+        auto allowed = [&](int cpu) { return !haveMask || (cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowedSet)); };
+
+        // Node numbers can have gaps (offline or memory-only nodes), so list the directory rather
+        // than counting up from node0.
+        std::map<int, std::vector<int>> nodes;
+        std::error_code ec;
+        for (fs::directory_iterator it("/sys/devices/system/node", ec), end; !ec && it != end; it.increment(ec)) {
+            std::string name = it->path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                !std::all_of(name.begin() + 4, name.end(), [](unsigned char c) { return std::isdigit(c); })) {
+                continue;
+            }
+            std::ifstream list(it->path() / "cpulist");
+            // "0-3,8-11"
+            std::vector<int> cpus;
+            std::string range;
+            while (std::getline(list, range, ',')) {
+                int first = std::atoi(range.c_str());
+                std::size_t dash = range.find('-');
+                int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    if (allowed(cpu)) cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) nodes[std::atoi(name.c_str() + 4)] = std::move(cpus);
+        }
+        for (auto& node : nodes) topology.nodeCpus.push_back(std::move(node.second));
+
+        if (topology.nodeCpus.empty() && haveMask) {
+            topology.nodeCpus.emplace_back();
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowedSet)) topology.nodeCpus[0].push_back(cpu);
+            }
+            if (topology.nodeCpus[0].empty()) topology.nodeCpus.clear();
+        }
+#endif
+        if (topology.nodeCpus.empty()) {
+            topology.nodeCpus.emplace_back();
+            for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+                topology.nodeCpus[0].push_back(static_cast<int>(cpu));
+            }
+        }
+        return topology;
+    }
+};
+
+// Pins the calling thread to one CPU. False if the kernel refused (e.g. the CPU went offline or a
+// cgroup forbids it) or affinity is not available; the thread then runs wherever it was.
+static bool pinCurrentThread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Hands out CPUs to pinned pipeline threads. Every pipeline of a run (one per root) draws from
+// the same per-node cursors, so lanes of different roots get disjoint cores until the machine is
+// full; only then do cores repeat. Only pins the kernel accepted are counted.
+class CpuAllocator {
+public:
+    // Node for a pipeline's first lane; successive pipelines start on successive nodes.
+    std::size_t firstNode() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nextNode_++ % CpuTopology::get().nodeCpus.size();
+    }
+
+    int take(std::size_t node) {
+        const std::vector<int>& cpus = CpuTopology::get().nodeCpus[node];
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (nextCpu_.size() <= node) nextCpu_.resize(node + 1, 0);
+        return cpus[nextCpu_[node]++ % cpus.size()];
+    }
+
+    // Called from the thread itself once pinCurrentThread(cpu) has returned.
+    void pinned(std::size_t node, int cpu, bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok) {
+            ++failedPins_;
+            return;
+        }
+        ++threadsPinned_;
+        usedCpus_.insert(cpu);
+        usedNodes_.insert(node);
+    }
+
+    std::size_t threadsPinned() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return threadsPinned_;
+    }
+
+    std::size_t failedPins() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failedPins_;
+    }
+
+    std::size_t cpusUsed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return usedCpus_.size();
+    }
+
+    std::size_t nodesUsed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return usedNodes_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::size_t nextNode_ = 0;
+    std::vector<std::size_t> nextCpu_;
+    std::set<int> usedCpus_;
+    std::set<std::size_t> usedNodes_;
+    std::size_t threadsPinned_ = 0;
+    std::size_t failedPins_ = 0;
+};
+
+// Reads and parses `names` on `workers` threads. Readers claim files in order, read each into a
+// pooled buffer and pass the buffer's slot number to the parsers through one ring; parsers take
+// slots in batches and hand the emptied buffers back through a second ring, so steady state
+// allocates nothing.
+//
+// onParsed(i, record) runs on the calling thread for names[i] in file order. Parsers drop records
+// into a reorder window as large as the buffer pool and the caller drains its contiguous prefix;
+// readers do not claim a file a whole window ahead of that, so at most one window of records is
+// ever held, however large the folder.
+//
+// With `pin` the workers are split into one lane per NUMA node, each with its own buffers and
+// rings and its threads pinned to cores of that node taken from `pin`. Buffers and records are first touched by
+// those threads, so reads and parses stay in node-local memory; only the in-order drain crosses nodes.
+static void readAndParsePipelined(const std::string& folderPath, const std::vector<std::string>& names,
+                                  std::size_t workers, CpuAllocator* pin, bool wantStamp, bool dropBehind,
+                                  const std::function<void(std::size_t)>& onClaim, const ParseFileFn& parse,
+                                  const ParsedFn& onParsed) {
+    struct Buffer {
+        std::size_t index = 0;
+        std::string content;
+        FileStamp stamp;
+    };
+    constexpr std::size_t kBatch = 16;
+    struct Lane {
+        std::vector<Buffer> buffers;
+        MpmcRing<std::uint32_t> freeSlots;
+        MpmcRing<std::uint32_t> filledSlots;
+        std::atomic<std::size_t> readersLeft{0};
+        std::size_t readerCount = 0;
+        std::size_t parserCount = 0;
+        std::size_t node = 0;
+
+        explicit Lane(std::size_t workers)
+            : buffers(4 * workers + kBatch), freeSlots(buffers.size()), filledSlots(buffers.size()) {
+            for (std::uint32_t slot = 0; slot < buffers.size(); ++slot) freeSlots.tryEnqueue(slot);
+            readerCount = std::max<std::size_t>(1, workers / 2);
+            parserCount = std::max<std::size_t>(1, workers - readerCount);
+            readersLeft.store(readerCount);
+        }
+    };
+
+    // A lane needs a reader and a parser, so small --jobs values use fewer lanes than nodes.
+    const CpuTopology& topology = CpuTopology::get();
+    std::size_t laneCount = pin ? std::max<std::size_t>(1, std::min(topology.nodeCpus.size(), workers / 2)) : 1;
+    std::size_t firstNode = pin ? pin->firstNode() : 0;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    for (std::size_t i = 0; i < laneCount; ++i) {
+        lanes.push_back(std::make_unique<Lane>(workers * (i + 1) / laneCount - workers * i / laneCount));
+        lanes.back()->node = (firstNode + i) % topology.nodeCpus.size();
+    }
+
+    struct Slot {
+        std::atomic<bool> ready{false};
+        PlaylistData data;
+    };
+    std::size_t windowSize = 0;
+    for (const auto& lane : lanes) windowSize += lane->buffers.size();
+    auto window = std::make_unique<Slot[]>(windowSize);
+    std::atomic<std::size_t> nextFile{0};
+    std::atomic<std::size_t> drained{0};
+
+    auto readLoop = [&](Lane& lane) {
+        nameTraceThread("reader");
+        DirectoryReader reader(folderPath);
+        reader.setDropBehind(dropBehind);
+        while (true) {
+            std::size_t index = nextFile.fetch_add(1, std::memory_order_relaxed);
+            if (index >= names.size()) break;
+            // Its window slot is free once the record windowSize files back has been drained.
+            while (index >= drained.load(std::memory_order_acquire) + windowSize) std::this_thread::yield();
+            onClaim(index);
+            std::uint32_t slot = 0;
+            while (lane.freeSlots.tryDequeueBatch(&slot, 1) == 0) std::this_thread::yield();
+            Buffer& buffer = lane.buffers[slot];
+            buffer.index = index;
+            buffer.stamp = FileStamp();
+            reader.read(names[index], buffer.content, wantStamp ? &buffer.stamp : nullptr);
+            while (!lane.filledSlots.tryEnqueue(slot)) std::this_thread::yield();
+        }
+        lane.readersLeft.fetch_sub(1, std::memory_order_release);
+    };
+
+    auto parseLoop = [&](Lane& lane) {
+        nameTraceThread("parser");
+        std::uint32_t batch[kBatch];
+        while (true) {
+            std::size_t count = lane.filledSlots.tryDequeueBatch(batch, kBatch);
+            if (count == 0) {
+                // Checked before the final dequeue: once every reader is gone, an empty ring stays empty.
+                if (lane.readersLeft.load(std::memory_order_acquire) == 0) {
+                    count = lane.filledSlots.tryDequeueBatch(batch, kBatch);
+                    if (count == 0) break;
+                } else {
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                Buffer& buffer = lane.buffers[batch[i]];
+                Slot& slot = window[buffer.index % windowSize];
+                slot.data = parse(names[buffer.index], buffer.content, buffer.stamp);
+                slot.ready.store(true, std::memory_order_release);
+                lane.freeSlots.tryEnqueue(batch[i]);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (auto& lanePtr : lanes) {
+        Lane& lane = *lanePtr;
+        auto spawn = [&](auto loop) {
+            int cpu = pin ? pin->take(lane.node) : -1;
+            threads.emplace_back([&lane, loop, cpu, pin] {
+                if (pin) pin->pinned(lane.node, cpu, pinCurrentThread(cpu));
+                loop(lane);
+            });
+        };
+        for (std::size_t i = 0; i < lane.readerCount; ++i) spawn(readLoop);
+        for (std::size_t i = 0; i < lane.parserCount; ++i) spawn(parseLoop);
+    }
+    for (std::size_t index = 0; index < names.size(); ++index) {
+        Slot& slot = window[index % windowSize];
+        while (!slot.ready.load(std::memory_order_acquire)) std::this_thread::yield();
+        onParsed(index, slot.data);
+        slot.data = PlaylistData();
+        slot.ready.store(false, std::memory_order_relaxed);
+        drained.store(index + 1, std::memory_order_release);
+    }
+    for (auto& thread : threads) thread.join();
+}
+
+#if defined(HAVE_GETDENTS64)
+// Same filter as `is_regular_file() && extension() == ".json"`, applied to the raw name bytes.
+// A bare ".json" has no extension in std::filesystem terms, so it is not a match.
+static bool hasJsonSuffix(const char* name, std::size_t length) {
+    return length > 5 && std::memcmp(name + length - 5, ".json", 5) == 0;
+}
+
+struct LinuxDirent64 {
+    std::uint64_t inode;
+    std::int64_t offset;
+    unsigned short recordLength;
+    unsigned char type;
+    char name[1];
+};
+
+// Reads the directory in large batches and trusts d_type; only entries the filesystem
+// reports as DT_UNKNOWN or symlinks are stat-ed, and only after the name already matched.
+static bool listJsonFilesLinux(const std::string& folderPath, std::vector<std::string>& names,
+                               std::vector<std::uint64_t>& inodes) {
+    int dirFd = ::open(folderPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return false;
+
+    std::vector<char> buffer(256 * 1024);
+    while (true) {
+        long bytes = ::syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+        if (bytes < 0) {
+            ::close(dirFd);
+            return false;
+        }
+        if (bytes == 0) break;
+
+        for (long offset = 0; offset < bytes;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+            offset += entry->recordLength;
+
+            std::size_t length = std::strlen(entry->name);
+            if (!hasJsonSuffix(entry->name, length)) continue;
+            std::uint64_t inode = entry->inode;
+            if (entry->type == DT_UNKNOWN || entry->type == DT_LNK) {
+                struct stat info;
+                if (::fstatat(dirFd, entry->name, &info, 0) != 0 || !S_ISREG(info.st_mode)) continue;
+                inode = static_cast<std::uint64_t>(info.st_ino);
+            } else if (entry->type != DT_REG) {
+                continue;
+            }
+            names.emplace_back(entry->name, length);
+            inodes.push_back(inode);
+        }
+    }
+
+    ::close(dirFd);
+    return true;
+}
+#endif
+
+// The portable enumerator: every entry becomes a path object, and is_regular_file() may stat it.
+static std::vector<std::string> listJsonFilesPortable(const std::string& folderPath) {
+    std::vector<std::string> names;
+    for (const auto& entry : fs::directory_iterator(folderPath)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    return names;
+}
+
+// File names (not paths) of the regular .json files directly inside folderPath, in directory order.
+// With `inodeOrder` they come back sorted by inode number where getdents64 reports it: on ext4 and
+// XFS that follows allocation order on disk, so a cold scan seeks forward instead of at random.
+static std::vector<std::string> listJsonFiles(const std::string& folderPath, bool inodeOrder) {
+    std::vector<std::string> names;
+#if defined(HAVE_GETDENTS64)
+    std::vector<std::uint64_t> inodes;
+    if (listJsonFilesLinux(folderPath, names, inodes)) {
+        if (!inodeOrder) return names;
+        std::vector<std::size_t> order(names.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&inodes](std::size_t a, std::size_t b) { return inodes[a] < inodes[b]; });
+        std::vector<std::string> sorted;
+        sorted.reserve(names.size());
+        for (std::size_t i : order) sorted.push_back(std::move(names[i]));
+        return sorted;
+    }
+#else
+    (void)inodeOrder;
+#endif
+    return listJsonFilesPortable(folderPath);
+}
+
+static void scanRoot(std::size_t rootIndex, const std::string& folderPath, const ScanOptions& options,
+                     std::size_t workers, DuplicateTracker& tracker, std::vector<PlaylistData>& results,
+                     CanonicalGroups& groups, ScenarioCounts& scenarioCounts, ParseCache* cache, CpuAllocator* cpus,
+                     RootStats& stats, int& duplicateNames) {
+    auto start = std::chrono::steady_clock::now();
+    // The longest-description policy and restored playlist files need descriptions even when they
+    // are not written out.
+    bool extractDescription = options.includeDescription || !options.emitJsonDir.empty() ||
+        (options.canonicalize && options.canonicalPolicy == CanonicalPolicy::LongestDescription);
+    // So do the catalog's author index and restored playlist files for authors.
+    bool extractAuthor = options.includeAuthor || !options.catalogDir.empty() || !options.emitJsonDir.empty();
+
+    TraceSpan enumerateSpan("enumerate");
+    std::vector<std::string> names = listJsonFiles(folderPath, !options.directoryOrder);
+    if (options.sharded()) {
+        names.erase(std::remove_if(names.begin(), names.end(),
+                                   [&options](const std::string& name) { return !inShard(name, options); }),
+                    names.end());
+    }
+    enumerateSpan.end();
+    stats.enumerateMs = millisecondsSince(start);
+    // Only the newest-file policy needs mtimes; everything else avoids a stat per file.
+    bool needModifiedTime = options.canonicalize && options.canonicalPolicy == CanonicalPolicy::Newest;
+
+    // Past this many files a one-off scan would mostly be evicting other data to cache files it
+    // never reads again. Watch mode rereads everything each cycle, so it keeps them.
+    constexpr std::size_t kDropBehindFiles = 100000;
+    bool dropBehind = !options.directoryOrder && options.watchSeconds == 0 && names.size() >= kDropBehindFiles;
+    bool wantStamp = needModifiedTime || cache;
+    DirectoryReader reader(folderPath);
+    reader.setDropBehind(dropBehind);
+#if defined(HAVE_FADVISE)
+    // The hinter costs an extra open/fadvise/close per file, which a warm cache never pays back;
+    // libraries below this size are usually still cached from the last run.
+    constexpr std::size_t kReadaheadFiles = 10000;
+    std::unique_ptr<ReadaheadHinter> hinter;
+    if (!options.directoryOrder && names.size() >= kReadaheadFiles) {
+        hinter = std::make_unique<ReadaheadHinter>(folderPath, names);
+    }
+#endif
+    auto onClaim = [&](std::size_t index) {
+#if defined(HAVE_FADVISE)
+        if (hinter) hinter->consumed(index);
+#else
+        (void)index;
+#endif
+    };
+
+    // A file that ends early and was written this recently is taken to be mid-save: it is rechecked
+    // every kRecheckInterval until it is complete or goes quiet, for at most kMaxDeferTime.
+    constexpr auto kSettleTime = std::chrono::milliseconds(2000);
+    constexpr auto kRecheckInterval = std::chrono::milliseconds(100);
+    constexpr auto kMaxDeferTime = std::chrono::milliseconds(5000);
+    std::vector<std::pair<std::size_t, std::shared_ptr<PartialFile>>> deferred;
+
+    bool includeScenarios = options.scenarioStats || !options.similarTo.empty() || options.keepScenarios();
+    // -f only counts scenarios when asked to.
+    bool scenarioCountKnown = options.fieldNames.empty() || includeScenarios || options.fieldTable.scenarioCountSlot >= 0;
+
+    // Everything per file that touches no shared scan state; safe to run on any worker.
+    std::once_flag firstFile;
+    ParseFileFn parseFile = [&](const std::string& name, const std::string& content, const FileStamp& stamp) {
+        PlaylistData data;
+        if (looksUnfinished(content) && reader.recentlyModified(name, kSettleTime)) {
+            auto partial = std::make_shared<PartialFile>();
+            partial->feed(content.data(), content.size());
+            if (partial->unfinished()) {
+                data.partial = std::move(partial);
+                data.rootIndex = rootIndex;
+                return data;
+            }
+        }
+        CacheKey key;
+        bool cached = false;
+        if (cache && !content.empty()) {
+            key.stamp = stamp;
+            key.contentHash = hashContent(content);
+            cached = cache->lookup(key, data);
+        }
+        ScanHistograms& histograms = HistogramRegistry::local();
+        if (!cached) {
+            TraceSpan span("parse");
+            span.setBytes(content.size());
+            auto parseStart = std::chrono::steady_clock::now();
+            data = parseJsonFile(reader, name, content, extractAuthor, extractDescription, includeScenarios,
+                                 options.fieldNames.empty() ? nullptr : &options.fieldTable);
+            histograms.parseNanos.record(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parseStart).count()));
+            if (cache && !content.empty()) cache->insert(key, data);
+        }
+        histograms.fileBytes.record(content.size());
+        if (!data.playlistName.empty() && !data.shareCode.empty()) {
+            if (extractDescription && options.fieldNames.empty()) histograms.descriptionBytes.record(data.description.size());
+            if (scenarioCountKnown) histograms.scenarioCount.record(static_cast<std::uint64_t>(data.scenarioCount));
+        }
+        data.rootIndex = rootIndex;
+        data.modifiedTime = stamp.modifiedTime;
+        if (!options.similarTo.empty() && !data.playlistName.empty() && !data.shareCode.empty()) {
+            data.minHash = computeMinHash(data.scenarios);
+        }
+        std::call_once(firstFile, [&stats] { stats.firstFileMs = millisecondsSince(processStart); });
+        return data;
+    };
+
+    // Counting and duplicate detection, always in file order so "first seen" does not depend on timing.
+    auto account = [&](std::size_t index, PlaylistData& data) {
+        if (data.partial) {
+            ++stats.deferredFiles;
+            deferred.emplace_back(index, std::move(data.partial));
+            return;
+        }
+        ++stats.fileCount;
+        if (!data.playlistName.empty() && !data.shareCode.empty()) {
+            ++stats.successfulParses;
+
+            if (options.scenarioStats) {
+                countScenarios(data.scenarios, scenarioCounts);
+            }
+            if (!options.keepScenarios()) {
+                data.scenarios.clear();
+                data.scenarios.shrink_to_fit();
+            }
+
+            // Check for duplicate share codes
+            if (tracker.addShareCode(data.shareCode, rootIndex)) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                *reportStream << "  [WARNING] Duplicate share code detected: " << data.shareCode << '\n';
+            }
+
+            // Check for duplicate playlist names
+            if (tracker.addPlaylistName(data.playlistName)) {
+                ++duplicateNames;
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                *reportStream << "  [WARNING] Duplicate playlist name detected: " << data.playlistName << '\n';
+            }
+
+            if (options.canonicalize && !options.sharded()) {
+                groups.offer(std::move(data));
+            } else {
+                results.push_back(std::move(data));
+            }
+        } else {
+            ++stats.failedParses;
+        }
+    };
+
+    // Small folders are not worth the thread start-up.
+    constexpr std::size_t kMinPipelineFiles = 256;
+    if (workers > 1 && names.size() >= kMinPipelineFiles) {
+        readAndParsePipelined(folderPath, names, workers, cpus, wantStamp, dropBehind, onClaim, parseFile,
+                              [&account](std::size_t index, PlaylistData& data) {
+                                  TraceSpan span("dedup");
+                                  account(index, data);
+                              });
+    } else {
+        std::string content;
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            onClaim(i);
+            FileStamp stamp;
+            reader.read(names[i], content, wantStamp ? &stamp : nullptr);
+            PlaylistData data = parseFile(names[i], content, stamp);
+            TraceSpan span("dedup");
+            account(i, data);
+        }
+    }
+
+    auto deferStart = std::chrono::steady_clock::now();
+    std::string appended;
+    while (!deferred.empty() && std::chrono::steady_clock::now() - deferStart < kMaxDeferTime) {
+        std::this_thread::sleep_for(kRecheckInterval);
+        TraceSpan span("recheck");
+        std::vector<std::pair<std::size_t, std::shared_ptr<PartialFile>>> pending;
+        for (auto& [index, partial] : deferred) {
+            const std::string& name = names[index];
+            FileStamp stamp;
+            std::uint64_t from = partial->offset - partial->tail.size();
+            if (!reader.read(name, appended, &stamp, from)) {
+                ++stats.deferredGone;  // e.g. a temporary file renamed into place
+                continue;
+            }
+            if (stamp.size < partial->offset || appended.compare(0, partial->tail.size(), partial->tail) != 0) {
+                // Rewritten from the start rather than appended to.
+                partial = std::make_shared<PartialFile>();
+                reader.read(name, appended, &stamp);
+                from = 0;
+            }
+            std::size_t skip = static_cast<std::size_t>(partial->offset - from);
+            partial->feed(appended.data() + skip, appended.size() - skip);
+
+            bool quiet = !reader.recentlyModified(name, kSettleTime);
+            if (!partial->complete && !quiet) {
+                pending.emplace_back(index, std::move(partial));
+                continue;
+            }
+            PlaylistData data;
+            if (partial->complete) {
+                ++stats.deferredFinished;
+                data = parseFile(name, partial->document, stamp);
+            } else {
+                // The writer stopped without finishing it; judge it like any other file.
+                reader.read(name, appended, &stamp);
+                data = parseFile(name, appended, stamp);
+            }
+            if (data.partial) {
+                // Written to again since the quiet check: keep waiting, but it was already counted as
+                // deferred, and account() must not append to `deferred` while it is being walked.
+                pending.emplace_back(index, std::move(data.partial));
+                continue;
+            }
+            account(index, data);
+        }
+        deferred.swap(pending);
+    }
+    stats.stillWriting += static_cast<int>(deferred.size());
+    stats.fileCount += stats.stillWriting;
+
+    stats.elapsedMs = millisecondsSince(start);
+}
+
+static void printTopScenarios(const std::vector<std::pair<std::string, ScenarioTotals>>& ranked, std::size_t topK,
+                              bool byPlays) {
+    std::vector<const std::pair<std::string, ScenarioTotals>*> order;
+    order.reserve(ranked.size());
+    for (const auto& item : ranked) order.push_back(&item);
+
+    auto key = [byPlays](const std::pair<std::string, ScenarioTotals>* item) {
+        return byPlays ? item->second.playCountSum : item->second.playlistCount;
+    };
+    std::size_t shown = std::min(topK, order.size());
+    std::partial_sort(order.begin(), order.begin() + shown, order.end(), [&](const auto* a, const auto* b) {
+        if (key(a) != key(b)) return key(a) > key(b);
+        return a->first < b->first;
+    });
+
+    for (std::size_t i = 0; i < shown; ++i) {
+        std::cout << "  " << (i + 1) << ". " << order[i]->first
+                  << " (playlists: " << order[i]->second.playlistCount
+                  << ", plays: " << order[i]->second.playCountSum << ")" << '\n';
+    }
+}
+
+// LSH candidates for `signature`, scored by estimated Jaccard similarity, best first.
+static std::vector<std::pair<double, std::size_t>> rankSimilar(const LshIndex& index, const std::vector<PlaylistData>& results,
+                                                               const std::vector<std::uint32_t>& signature) {
+    std::vector<std::pair<double, std::size_t>> scored;
+    for (std::size_t candidate : index.candidates(signature)) {
+        scored.emplace_back(estimateJaccard(signature, results[candidate].minHash), candidate);
+    }
+    std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) {
+        if (a.first != b.first) return a.first > b.first;
+        return a.second < b.second;
+    });
+    return scored;
+}
+
+static void printSimilarPlaylists(const std::vector<PlaylistData>& results, const std::string& shareCode,
+                                  std::size_t topK) {
+    std::cout << '\n';
+    std::cout << "=== SIMILAR PLAYLISTS ===" << '\n';
+
+    auto buildStart = std::chrono::steady_clock::now();
+    LshIndex index;
+    index.build(results);
+    auto queryStart = std::chrono::steady_clock::now();
+
+    auto target = std::find_if(results.begin(), results.end(), [&](const PlaylistData& data) {
+        return data.shareCode == shareCode;
+    });
+    if (target == results.end() || target->minHash.empty()) {
+        std::cout << "No playlist with scenarios found for share code: " << shareCode << '\n';
+        std::cout << "=========================" << '\n';
+        return;
+    }
+
+    std::vector<std::pair<double, std::size_t>> scored = rankSimilar(index, results, target->minHash);
+    std::set<std::string> seenShareCodes{shareCode};
+    auto queryEnd = std::chrono::steady_clock::now();
+
+    std::cout << "Query: " << target->playlistName << " (" << shareCode << ")" << '\n';
+    std::size_t shown = 0;
+    for (const auto& [similarity, candidate] : scored) {
+        if (shown == topK) break;
+        const PlaylistData& match = results[candidate];
+        if (!seenShareCodes.insert(match.shareCode).second) continue;
+        ++shown;
+        std::cout << "  " << shown << ". " << match.playlistName << " (" << match.shareCode << ")"
+                  << " similarity ~" << similarity << '\n';
+    }
+    if (shown == 0) {
+        std::cout << "  (no similar playlists found)" << '\n';
+    }
+    std::cout << "Index build: " << std::chrono::duration<double, std::milli>(queryStart - buildStart).count()
+              << " ms, query: " << std::chrono::duration<double, std::milli>(queryEnd - queryStart).count()
+              << " ms" << '\n';
+    std::cout << "=========================" << '\n';
+}
+
+// One full pass over every root: scan, merge, report and write the results file.
+// `mainEntryMs` is negative when the startup breakdown should not be reported (later watch cycles).
+static void runScan(const std::vector<std::string>& folderPaths, const ScanOptions& options, const std::string& outputFile,
+                    ParseCache* cache, double mainEntryMs) {
+    for (const auto& folderPath : folderPaths) {
+        std::cout << "Scanning folder: " << folderPath << '\n';
+    }
+    std::cout << '\n';
+
+    // Each root gets its own scanner thread and result list; only the duplicate tracker is shared.
+    DuplicateTracker tracker;
+    std::vector<std::vector<PlaylistData>> rootResults(folderPaths.size());
+    std::vector<CanonicalGroups> rootGroups(folderPaths.size());
+    std::vector<ScenarioCounts> rootScenarioCounts(folderPaths.size());
+    for (auto& groups : rootGroups) {
+        groups.policy = options.canonicalPolicy;
+    }
+    std::vector<RootStats> rootStats(folderPaths.size());
+    std::vector<int> rootDuplicateNames(folderPaths.size(), 0);
+    CpuAllocator cpuAllocator;
+    CpuAllocator* cpus = options.pinThreads ? &cpuAllocator : nullptr;
+    auto scanStart = std::chrono::steady_clock::now();
+
+    if (folderPaths.size() == 1) {
+        rootStats[0].path = folderPaths[0];
+        scanRoot(0, folderPaths[0], options, options.jobs, tracker, rootResults[0], rootGroups[0],
+                 rootScenarioCounts[0], cache, cpus, rootStats[0], rootDuplicateNames[0]);
+    } else {
+        // The --jobs budget is split between the roots.
+        std::size_t workersPerRoot = std::max<std::size_t>(1, options.jobs / folderPaths.size());
+        std::vector<std::thread> scanners;
+        for (std::size_t i = 0; i < folderPaths.size(); ++i) {
+            rootStats[i].path = folderPaths[i];
+            scanners.emplace_back([&, i, workersPerRoot] {
+                nameTraceThread("root scanner");
+                scanRoot(i, folderPaths[i], options, workersPerRoot, tracker, rootResults[i], rootGroups[i],
+                         rootScenarioCounts[i], cache, cpus, rootStats[i], rootDuplicateNames[i]);
+            });
+        }
+        for (auto& scanner : scanners) {
+            scanner.join();
+        }
+    }
+
+    double scanMs = millisecondsSince(scanStart);
+    ScanHistograms histograms = HistogramRegistry::collect();
+    double startupMs = std::chrono::duration<double, std::milli>(scanStart - processStart).count();
+    double firstFileMs = -1.0;
+    for (const auto& stats : rootStats) {
+        if (stats.firstFileMs >= 0.0 && (firstFileMs < 0.0 || stats.firstFileMs < firstFileMs)) {
+            firstFileMs = stats.firstFileMs;
+        }
+    }
+
+    std::vector<PlaylistData> results;
+    int fileCount = 0;
+    int successfulParses = 0;
+    int failedParses = 0;
+    int deferredFiles = 0;
+    int deferredFinished = 0;
+    int stillWriting = 0;
+    int deferredGone = 0;
+    int duplicateShareCodes = 0;
+    int duplicateNames = 0;
+    // Shards keep every copy; the merge subcommand canonicalizes across all of them.
+    bool canonicalize = options.canonicalize && !options.sharded();
+    CanonicalGroups canonical;
+    canonical.policy = options.canonicalPolicy;
+    for (std::size_t i = 0; i < folderPaths.size(); ++i) {
+        if (canonicalize) {
+            // Root leaders are merged in root order, so ties still go to the lowest-numbered root.
+            for (auto& leader : rootGroups[i].leaders) {
+                canonical.offer(std::move(leader));
+            }
+        } else {
+            results.insert(results.end(), rootResults[i].begin(), rootResults[i].end());
+        }
+        fileCount += rootStats[i].fileCount;
+        successfulParses += rootStats[i].successfulParses;
+        failedParses += rootStats[i].failedParses;
+        deferredFiles += rootStats[i].deferredFiles;
+        deferredFinished += rootStats[i].deferredFinished;
+        stillWriting += rootStats[i].stillWriting;
+        deferredGone += rootStats[i].deferredGone;
+        duplicateNames += rootDuplicateNames[i];
+    }
+    if (canonicalize) {
+        results = std::move(canonical.leaders);
+    }
+
+    ScenarioCounts scenarioCounts = std::move(rootScenarioCounts[0]);
+    for (std::size_t i = 1; i < rootScenarioCounts.size(); ++i) {
+        for (const auto& [name, totals] : rootScenarioCounts[i]) {
+            ScenarioTotals& merged = scenarioCounts[name];
+            merged.playlistCount += totals.playlistCount;
+            merged.playCountSum += totals.playCountSum;
+        }
+    }
+
+    // The first copy of each share code belongs to the lowest-numbered root holding it;
+    // every other copy counts as a duplicate of the root it was found in.
+    std::vector<std::pair<std::string, const std::vector<std::size_t>*>> crossRootDuplicates;
+    tracker.shareCodeRoots.forEach([&](const std::string& shareCode, const std::vector<std::size_t>& roots) {
+        std::size_t owner = *std::min_element(roots.begin(), roots.end());
+        bool ownerSkipped = false;
+        bool crossRoot = false;
+        for (std::size_t root : roots) {
+            if (root == owner && !ownerSkipped) {
+                ownerSkipped = true;
+                continue;
+            }
+            ++rootStats[root].duplicateShareCodes;
+            ++duplicateShareCodes;
+            if (root != owner) crossRoot = true;
+        }
+        if (crossRoot) crossRootDuplicates.emplace_back(shareCode, &roots);
+    });
+    std::sort(crossRootDuplicates.begin(), crossRootDuplicates.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    if (!options.skipStats) {
+        std::cout << '\n';
+        std::cout << "=== STATISTICS ===" << '\n';
+        std::cout << "Total files processed: " << fileCount << '\n';
+        std::cout << "Successful parses: " << successfulParses << '\n';
+        std::cout << "Failed parses: " << failedParses << '\n';
+        std::cout << "Deferred (mid-save) files: " << deferredFiles;
+        if (deferredFiles > 0) {
+            std::cout << " (finished on recheck: " << deferredFinished << ", still being written: " << stillWriting
+                      << ", gone before recheck: " << deferredGone << ")";
+        }
+        std::cout << '\n';
+        std::cout << "Duplicate share codes: " << duplicateShareCodes << '\n';
+        std::cout << "Duplicate playlist names: " << duplicateNames << '\n';
+        if (canonicalize) {
+            std::cout << "Canonical records written: " << results.size() << '\n';
+        }
+        if (options.sharded()) {
+            std::cout << "Shard: " << (options.shardIndex + 1) << " of " << options.shardCount << '\n';
+        }
+        if (options.pinThreads) {
+            // Small roots skip the pipeline, so this can be fewer than --jobs or even none.
+            std::cout << "Workers: " << options.jobs << ", " << cpuAllocator.threadsPinned() << " thread(s) pinned to "
+                      << cpuAllocator.cpusUsed() << " CPU(s) on " << cpuAllocator.nodesUsed() << " of "
+                      << CpuTopology::get().nodeCpus.size() << " NUMA node(s)";
+            if (cpuAllocator.failedPins() > 0) std::cout << ", " << cpuAllocator.failedPins() << " pin(s) refused";
+            std::cout << '\n';
+        }
+        std::cout << "Scan time: " << scanMs << " ms" << '\n';
+        if (folderPaths.size() == 1) {
+            std::cout << "Enumeration time: " << rootStats[0].enumerateMs << " ms" << '\n';
+        }
+        if (mainEntryMs >= 0.0) {
+            std::cout << "Startup: " << startupMs << " ms (static init " << mainEntryMs << " ms)" << '\n';
+            if (firstFileMs >= 0.0) {
+                std::cout << "Time to first file: " << firstFileMs << " ms" << '\n';
+            }
+        }
+        if (cache) {
+            std::cout << "Cache hits: " << cache->hits << ", misses: " << cache->misses
+                      << ", evictions: " << cache->evictions << '\n';
+            std::cout << "Cache memory: " << cache->usedBytes / 1024 << " KiB of " << cache->budgetBytes / 1024
+                      << " KiB (" << cache->entries.size() << " records)" << '\n';
+        }
+        printHistograms(std::cout, histograms);
+        if (folderPaths.size() > 1) {
+            std::cout << "Roots scanned: " << folderPaths.size() << '\n';
+            std::cout << "Cross-root duplicate share codes: " << crossRootDuplicates.size() << '\n';
+            for (std::size_t i = 0; i < rootStats.size(); ++i) {
+                const RootStats& stats = rootStats[i];
+                std::cout << '\n';
+                std::cout << "[" << (i + 1) << "] " << stats.path << '\n';
+                std::cout << "  Files processed: " << stats.fileCount << '\n';
+                std::cout << "  Successful parses: " << stats.successfulParses << '\n';
+                std::cout << "  Failed parses: " << stats.failedParses << '\n';
+                std::cout << "  Deferred (mid-save) files: " << stats.deferredFiles << '\n';
+                std::cout << "  Duplicate share codes: " << stats.duplicateShareCodes << '\n';
+                std::cout << "  Scan time: " << stats.elapsedMs << " ms (enumeration " << stats.enumerateMs << " ms)" << '\n';
+            }
+            if (!crossRootDuplicates.empty()) {
+                std::cout << '\n';
+                std::cout << "Cross-root duplicates (share code: root [copies]...):" << '\n';
+                for (const auto& [shareCode, roots] : crossRootDuplicates) {
+                    std::map<std::size_t, int> copies;
+                    for (std::size_t root : *roots) ++copies[root];
+                    std::cout << "  " << shareCode << ":";
+                    for (const auto& [root, count] : copies) {
+                        std::cout << " [" << (root + 1) << "]x" << count;
+                    }
+                    std::cout << '\n';
+                }
+            }
+        }
+        std::cout << "==================" << '\n';
+    }
+
+    if (options.scenarioStats) {
+        std::vector<std::pair<std::string, ScenarioTotals>> ranked(scenarioCounts.begin(), scenarioCounts.end());
+        std::cout << '\n';
+        std::cout << "=== SCENARIO STATS ===" << '\n';
+        std::cout << "Distinct scenarios: " << ranked.size() << '\n';
+        std::cout << "Top " << std::min(options.topK, ranked.size()) << " by playlist count:" << '\n';
+        printTopScenarios(ranked, options.topK, false);
+        std::cout << "Top " << std::min(options.topK, ranked.size()) << " by total play count:" << '\n';
+        printTopScenarios(ranked, options.topK, true);
+        std::cout << "======================" << '\n';
+    }
+
+    if (!options.similarTo.empty()) {
+        printSimilarPlaylists(results, options.similarTo, options.topK);
+    }
+
+    if (options.sharded()) {
+        // Written even when empty so the merge can tell a quiet shard from a missing one.
+        std::cout << '\n';
+        writeShardFile(results, outputFile, options, fileCount, successfulParses, failedParses);
+    } else if (fileCount == 0) {
+        std::cout << "\nNo .json files found in the " << (folderPaths.size() > 1 ? "directories." : "directory.") << '\n';
+    } else if (successfulParses > 0) {
+        std::cout << '\n';
+        writeResultsToFile(results, outputFile, options);
+        if (!options.catalogDir.empty()) writeCatalog(results, options);
+        if (!options.emitJsonDir.empty()) emitPlaylistFiles(results, options);
+    } else {
+        std::cout << "\nNo valid results to write." << '\n';
+    }
+}
+
+// --stdin: playlists arrive on standard input and results leave on standard output as soon as
+// each read has been processed, so a pipeline sees every record without waiting for EOF.
+// Output is flushed at least every kFlushBytes; diagnostics and statistics go to stderr.
+static int runStdin(const ScanOptions& options, JsonStreamSplitter::Framing framing) {
+    constexpr std::size_t kReadBytes = 64 * 1024;
+    constexpr std::size_t kFlushBytes = 64 * 1024;
+    reportStream = &std::cerr;
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+    bool extractDescription = options.includeDescription;
+    bool includeScenarios = options.scenarioStats;
+    DirectoryReader reader("<stdin>");
+    DuplicateTracker tracker;
+    JsonStreamSplitter splitter(framing);
+    std::vector<PlaylistData> record(1);
+    std::string content;
+    std::string chunk;
+    std::string out;
+    std::vector<char> input(kReadBytes);
+    // Fixed-size, so a pipe that stays open for days does not grow it.
+    LogHistogram latencyNanos;
+    std::size_t pendingRecords = 0;
+
+    long long documents = 0;
+    long long successfulParses = 0;
+    long long failedParses = 0;
+    long long duplicateShareCodes = 0;
+    long long duplicateNames = 0;
+    std::uint64_t bytesIn = 0;
+    auto start = std::chrono::steady_clock::now();
+    // Records are timed from the read that completed them.
+    std::chrono::steady_clock::time_point arrived;
+
+    auto flush = [&] {
+        if (out.empty()) return;
+        TraceSpan span("write");
+        span.setBytes(out.size());
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+        std::cout.flush();
+        out.clear();
+        // Every buffered record came from the latest read, so they all share one latency.
+        auto latency = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - arrived).count());
+        for (; pendingRecords > 0; --pendingRecords) latencyNanos.record(latency);
+    };
+
+    auto onDocument = [&](std::string_view document) {
+        ++documents;
+        content.assign(document.data(), document.size());
+        ScanHistograms& histograms = HistogramRegistry::local();
+        TraceSpan parseSpan("parse");
+        parseSpan.setBytes(content.size());
+        auto parseStart = std::chrono::steady_clock::now();
+        PlaylistData data = parseJsonFile(reader, "stdin#" + std::to_string(documents), content,
+                                          options.includeAuthor, extractDescription, includeScenarios,
+                                          options.fieldNames.empty() ? nullptr : &options.fieldTable);
+        histograms.parseNanos.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parseStart).count()));
+        histograms.fileBytes.record(content.size());
+        parseSpan.end();
+        if (data.playlistName.empty() || data.shareCode.empty()) {
+            ++failedParses;
+            return;
+        }
+        ++successfulParses;
+        TraceSpan dedupSpan("dedup");
+        if (extractDescription && options.fieldNames.empty()) histograms.descriptionBytes.record(data.description.size());
+        if (options.fieldNames.empty()) histograms.scenarioCount.record(static_cast<std::uint64_t>(data.scenarioCount));
+        if (tracker.addShareCode(data.shareCode, 0)) {
+            ++duplicateShareCodes;
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            *reportStream << "  [WARNING] Duplicate share code detected: " << data.shareCode << '\n';
+        }
+        if (tracker.addPlaylistName(data.playlistName)) {
+            ++duplicateNames;
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            *reportStream << "  [WARNING] Duplicate playlist name detected: " << data.playlistName << '\n';
+        }
+        dedupSpan.end();
+        record[0] = std::move(data);
+        formatResults(record, 0, 1, options, chunk);
+        out.append(chunk);
+        ++pendingRecords;
+        if (out.size() >= kFlushBytes) flush();
+    };
+
+    while (true) {
+        TraceSpan readSpan("read");
+#if defined(_WIN32)
+        long long bytes = _read(0, input.data(), static_cast<unsigned>(input.size()));
+#elif defined(__linux__)
+        long long bytes = ::read(STDIN_FILENO, input.data(), input.size());
+#else
+        long long bytes = static_cast<long long>(std::fread(input.data(), 1, input.size(), stdin));
+#endif
+        if (bytes <= 0) break;
+        readSpan.setBytes(static_cast<std::uint64_t>(bytes));
+        readSpan.end();
+        bytesIn += static_cast<std::uint64_t>(bytes);
+        arrived = std::chrono::steady_clock::now();
+        splitter.feed(input.data(), static_cast<std::size_t>(bytes), onDocument);
+        // Nothing waits for the next read: whatever this read completed goes out now.
+        flush();
+    }
+    splitter.finish(onDocument);
+    flush();
+    double elapsedMs = millisecondsSince(start);
+
+    if (!options.skipStats) {
+        // Bucket bounds, so within 12.5% of the exact value.
+        auto percentile = [&latencyNanos](double p) { return latencyNanos.quantile(p) / 1000.0; };
+        double seconds = elapsedMs / 1000.0;
+        std::cerr << '\n';
+        std::cerr << "=== STATISTICS ===" << '\n';
+        std::cerr << "Documents read: " << documents << '\n';
+        std::cerr << "Successful parses: " << successfulParses << '\n';
+        std::cerr << "Failed parses: " << failedParses << '\n';
+        std::cerr << "Duplicate share codes: " << duplicateShareCodes << '\n';
+        std::cerr << "Duplicate playlist names: " << duplicateNames << '\n';
+        std::cerr << "Skipped bytes: " << splitter.skippedBytes() << ", incomplete at end of input: "
+                  << splitter.pendingBytes() << '\n';
+        std::cerr << "Input: " << bytesIn << " bytes in " << elapsedMs << " ms";
+        if (seconds > 0.0) {
+            std::cerr << " (" << bytesIn / (1024.0 * 1024.0) / seconds << " MiB/s, "
+                      << static_cast<long long>(documents / seconds) << " records/sec)";
+        }
+        std::cerr << '\n';
+        std::cerr << "Record latency (read to written): p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+                  << " us, max " << latencyNanos.max() / 1000.0 << " us" << '\n';
+        printHistograms(std::cerr, HistogramRegistry::collect());
+        std::cerr << "==================" << '\n';
+    }
+    return 0;
+}
+
+// The merge subcommand: k-way merges the share-code-sorted shard files, so duplicates of a share
+// code arrive back to back whichever shards they came from.
+static int runMerge(const std::vector<std::string>& shardFiles, ScanOptions& options, const std::string& outputFile) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<ShardReader>> readers;
+    std::vector<ShardHeader> headers(shardFiles.size());
+    std::set<std::uint32_t> shardIndexes;
+    std::uint64_t fileCount = 0;
+    std::uint64_t successfulParses = 0;
+    std::uint64_t failedParses = 0;
+    for (std::size_t i = 0; i < shardFiles.size(); ++i) {
+        std::cout << "Merging shard file: " << shardFiles[i] << '\n';
+        readers.push_back(std::make_unique<ShardReader>(shardFiles[i]));
+        if (!readers[i]->readHeader(headers[i])) {
+            std::cerr << "Error: Not a shard file: " << shardFiles[i] << std::endl;
+            return 1;
+        }
+        if (headers[i].shardCount != headers[0].shardCount || headers[i].fieldNames != headers[0].fieldNames) {
+            std::cerr << "Error: " << shardFiles[i] << " comes from a different --shard or --fields run than "
+                      << shardFiles[0] << std::endl;
+            return 1;
+        }
+        if (!shardIndexes.insert(headers[i].shardIndex).second) {
+            std::cerr << "Error: Shard " << (headers[i].shardIndex + 1) << " given twice" << std::endl;
+            return 1;
+        }
+        fileCount += headers[i].fileCount;
+        successfulParses += headers[i].successfulParses;
+        failedParses += headers[i].failedParses;
+    }
+
+    if (!headers[0].fieldNames.empty()) {
+        if (!options.fieldNames.empty() && options.fieldNames != headers[0].fieldNames) {
+            std::cerr << "Error: -f/--fields does not match the fields recorded in the shard files" << std::endl;
+            return 1;
+        }
+        options.fieldNames = headers[0].fieldNames;
+        options.fieldTable = FieldTable::compile(options.fieldNames, false, false, false);
+    } else if (!options.fieldNames.empty()) {
+        std::cerr << "Error: the shard files were not written with -f/--fields" << std::endl;
+        return 1;
+    }
+
+    // Min-heap over each shard's current record; equal share codes come out in shard-file order.
+    std::vector<PlaylistData> heads(readers.size());
+    auto later = [&heads](std::size_t a, std::size_t b) {
+        if (heads[a].shareCode != heads[b].shareCode) return heads[a].shareCode > heads[b].shareCode;
+        return a > b;
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> pending(later);
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->nextRecord(heads[i])) pending.push(i);
+    }
+
+    // Merged records are formatted and written a batch at a time as the walk produces them, so a
+    // merge holds one batch rather than every shard's records. The catalog and --emit-json need all
+    // of them at once, so only with those are the written batches also kept in `results`.
+    // (merge has no --similar: shard files do not carry scenarios.)
+    // A batch is cut at whichever limit comes first, so long descriptions do not swell it.
+    constexpr std::size_t kWriteBatch = 16384;
+    constexpr std::size_t kWriteBatchBytes = 8 * 1024 * 1024;
+    bool keepAll = !options.catalogDir.empty() || !options.emitJsonDir.empty();
+    std::size_t formatThreads = std::max(1u, std::thread::hardware_concurrency());
+    ResultFileWriter writer(outputFile);
+    bool opened = false;
+    bool writeFailed = false;
+    std::uint64_t recordsWritten = 0;
+    std::vector<PlaylistData> batch;
+    std::size_t batchBytes = 0;
+    std::vector<PlaylistData> results;
+    auto writeBatch = [&] {
+        if (batch.empty()) return;
+        batchBytes = 0;
+        recordsWritten += batch.size();
+        if (!writeFailed) {
+            if (!opened) writeFailed = !(opened = writer.open());
+            if (!writeFailed) writeFailed = !writer.write(formatChunks(batch, options, formatThreads));
+        }
+        if (keepAll) results.insert(results.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        batch.clear();
+    };
+
+    // The newest record is held back until the next share code arrives, since a later copy may
+    // still replace it as canonical.
+    PlaylistData current;
+    bool haveCurrent = false;
+    std::uint64_t duplicateShareCodes = 0;
+    while (!pending.empty()) {
+        std::size_t shard = pending.top();
+        pending.pop();
+        PlaylistData data = std::move(heads[shard]);
+        if (readers[shard]->nextRecord(heads[shard])) pending.push(shard);
+
+        if (haveCurrent && data.shareCode == current.shareCode) {
+            ++duplicateShareCodes;
+            if (options.canonicalize) {
+                if (isBetterCanonical(data, current, options.canonicalPolicy)) current = std::move(data);
+                continue;
+            }
+        }
+        if (haveCurrent) {
+            batchBytes += current.playlistName.size() + current.shareCode.size() + current.authorName.size() +
+                          current.authorSteamId.size() + current.description.size() + current.fields.bytes.size();
+            batch.push_back(std::move(current));
+            if (batch.size() >= kWriteBatch || batchBytes >= kWriteBatchBytes) writeBatch();
+        }
+        current = std::move(data);
+        haveCurrent = true;
+    }
+    if (haveCurrent) batch.push_back(std::move(current));
+    writeBatch();
+    if (opened && !writeFailed) writeFailed = !writer.close();
+
+    // Same k-way walk over the name sections: every copy after the first is a duplicate name.
+    std::vector<std::pair<std::string, std::uint64_t>> nameHeads(readers.size());
+    auto laterName = [&nameHeads](std::size_t a, std::size_t b) { return nameHeads[a].first > nameHeads[b].first; };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(laterName)> pendingNames(laterName);
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->nextName(nameHeads[i].first, nameHeads[i].second)) pendingNames.push(i);
+    }
+    std::uint64_t nameCopies = 0;
+    std::uint64_t distinctNames = 0;
+    std::string previousName;
+    while (!pendingNames.empty()) {
+        std::size_t shard = pendingNames.top();
+        pendingNames.pop();
+        if (distinctNames == 0 || nameHeads[shard].first != previousName) {
+            ++distinctNames;
+            previousName = nameHeads[shard].first;
+        }
+        nameCopies += nameHeads[shard].second;
+        if (readers[shard]->nextName(nameHeads[shard].first, nameHeads[shard].second)) pendingNames.push(shard);
+    }
+
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (readers[i]->failed()) {
+            std::cerr << "Error: Truncated or corrupt shard file: " << shardFiles[i] << std::endl;
+            // Do not leave a results file that silently stops partway.
+            if (opened) {
+                std::error_code ec;
+                fs::remove(outputFile, ec);
+            }
+            return 1;
+        }
+    }
+    // Includes formatting and writing the results file, which happens during the walk.
+    double mergeMs = millisecondsSince(start);
+
+    if (!options.skipStats) {
+        std::cout << '\n';
+        std::cout << "=== STATISTICS ===" << '\n';
+        std::cout << "Shards merged: " << readers.size() << " of " << headers[0].shardCount << '\n';
+        if (readers.size() < headers[0].shardCount) {
+            std::cout << "  [WARNING] Missing shards:";
+            for (std::uint32_t i = 0; i < headers[0].shardCount; ++i) {
+                if (!shardIndexes.count(i)) std::cout << ' ' << (i + 1);
+            }
+            std::cout << '\n';
+        }
+        std::cout << "Total files processed: " << fileCount << '\n';
+        std::cout << "Successful parses: " << successfulParses << '\n';
+        std::cout << "Failed parses: " << failedParses << '\n';
+        std::cout << "Duplicate share codes: " << duplicateShareCodes << '\n';
+        std::cout << "Duplicate playlist names: " << (nameCopies - distinctNames) << '\n';
+        if (options.canonicalize) {
+            std::cout << "Canonical records written: " << recordsWritten << '\n';
+        }
+        std::cout << "Merge time: " << mergeMs << " ms" << '\n';
+        std::cout << "==================" << '\n';
+    }
+
+    if (recordsWritten == 0) {
+        std::cout << "\nNo valid results to write." << '\n';
+    } else {
+        std::cout << '\n';
+        if (!writeFailed) std::cout << "Results written to " << outputFile << '\n';
+        if (!options.catalogDir.empty()) writeCatalog(results, options);
+        if (!options.emitJsonDir.empty()) emitPlaylistFiles(results, options);
+    }
+    return 0;
+}
+
+#if defined(JSON_PARSER_DIFFTEST) || defined(JSON_PARSER_FUZZ)
+// ---- Differential checking of the extraction backends ----
+//
+// Every backend sees the same document; raw (still escaped) results are decoded before comparing,
+// so the checker reports real disagreements rather than representation differences.
+
+#include <random>
+#if defined(__linux__)
+#  include <signal.h>
+#  include <sys/ptrace.h>
+#  include <sys/wait.h>
+#endif
+
+// Decodes the body of a JSON string literal. Malformed escapes are kept verbatim.
+static std::string decodeJsonString(const std::string& raw) {
+    std::string out;
+    out.reserve(raw.size());
+    auto appendUtf8 = [&out](std::uint32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    };
+    auto readHex = [&raw](std::size_t pos, std::uint32_t& value) {
+        if (pos + 4 > raw.size()) return false;
+        value = 0;
+        for (std::size_t i = pos; i < pos + 4; ++i) {
+            char c = raw[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= static_cast<std::uint32_t>(c - '0');
+            else if (c >= 'a' && c <= 'f') value |= static_cast<std::uint32_t>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') value |= static_cast<std::uint32_t>(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    };
+
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\' || i + 1 >= raw.size()) {
+            out += raw[i];
+            continue;
+        }
+        char escape = raw[i + 1];
+        switch (escape) {
+        case '"': out += '"'; ++i; break;
+        case '\\': out += '\\'; ++i; break;
+        case '/': out += '/'; ++i; break;
+        case 'b': out += '\b'; ++i; break;
+        case 'f': out += '\f'; ++i; break;
+        case 'n': out += '\n'; ++i; break;
+        case 'r': out += '\r'; ++i; break;
+        case 't': out += '\t'; ++i; break;
+        case 'u': {
+            std::uint32_t cp;
+            if (!readHex(i + 2, cp)) {
+                out += raw[i];
+                break;
+            }
+            i += 5;
+            std::uint32_t low;
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u' &&
+                readHex(i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+            appendUtf8(cp);
+            break;
+        }
+        default:
+            out += raw[i];
+            break;
+        }
+    }
+    return out;
+}
+
+enum DiffField {
+    kFieldPlaylistName,
+    kFieldShareCode,
+    kFieldAuthorName,
+    kFieldAuthorSteamId,
+    kFieldDescription,
+    kFieldScenarioCount,
+    kFieldScenarios,
+    kFieldCount
+};
+
+static const char* const kDiffFieldNames[kFieldCount] = {
+    "playlistName", "shareCode", "authorName", "authorSteamId", "description", "scenarioCount", "scenarioList"};
+
+struct DiffBackend {
+    const char* name;
+    unsigned fields;  // bit per DiffField
+    bool rawStrings;  // values still carry JSON escapes
+    void (*extract)(const std::string& content, PlaylistData& data);
+};
+
+static const DiffBackend kDiffBackends[] = {
+#if defined(HAVE_NLOHMANN_JSON)
+    {"nlohmann", (1u << kFieldPlaylistName) | (1u << kFieldShareCode) | (1u << kFieldAuthorName) |
+                     (1u << kFieldAuthorSteamId) | (1u << kFieldDescription) | (1u << kFieldScenarioCount),
+     false, [](const std::string& content, PlaylistData& data) { extractWithNlohmann(content, true, true, data); }},
+#endif
+    {"regex", (1u << kFieldPlaylistName) | (1u << kFieldShareCode) | (1u << kFieldAuthorName) |
+                  (1u << kFieldAuthorSteamId) | (1u << kFieldDescription) | (1u << kFieldScenarioCount),
+     true, [](const std::string& content, PlaylistData& data) {
+         extractWithRegex(content, true, true, data);
+         data.scenarioCount = countScenarioNames(content);
+     }},
+    {"field-scanner", (1u << kFieldPlaylistName) | (1u << kFieldShareCode) | (1u << kFieldAuthorName) |
+                          (1u << kFieldAuthorSteamId) | (1u << kFieldDescription),
+     true, [](const std::string& content, PlaylistData& data) {
+         static const FieldTable table = FieldTable::compile(
+             {"playlistName", "shareCode", "authorName", "authorSteamId", "description"}, false, false, false);
+         std::vector<std::string_view> values;
+         extractFieldValues(content, table, values);
+         data.playlistName = values[table.playlistNameSlot];
+         data.shareCode = values[table.shareCodeSlot];
+         data.authorName = values[table.authorNameSlot];
+         data.authorSteamId = values[table.authorSteamIdSlot];
+         data.description = values[table.descriptionSlot];
+     }},
+    {"pointer-scanner", (1u << kFieldPlaylistName) | (1u << kFieldShareCode) | (1u << kFieldAuthorName) |
+                            (1u << kFieldAuthorSteamId) | (1u << kFieldDescription),
+     true, [](const std::string& content, PlaylistData& data) {
+         static const FieldTable table = FieldTable::compile(
+             {"/playlistName", "/shareCode", "/authorName", "/authorSteamId", "/description", "/meta/playlistName"}, false, false, false);
+         std::vector<std::string_view> values;
+         extractFieldValues(content, table, values);
+         data.playlistName = values[0];
+         data.shareCode = values[1];
+         data.authorName = values[2];
+         data.authorSteamId = values[3];
+         data.description = values[4];
+     }},
+    {"scenario-scanner", (1u << kFieldScenarioCount) | (1u << kFieldScenarios), true,
+     [](const std::string& content, PlaylistData& data) {
+         if (extractScenarios(content, data.scenarios)) data.scenarioCount = static_cast<int>(data.scenarios.size());
+     }},
+};
+
+static std::string describeField(const PlaylistData& data, DiffField field, bool rawStrings) {
+    auto text = [rawStrings](const std::string& value) { return rawStrings ? decodeJsonString(value) : value; };
+    switch (field) {
+    case kFieldPlaylistName: return text(data.playlistName);
+    case kFieldShareCode: return text(data.shareCode);
+    case kFieldAuthorName: return text(data.authorName);
+    case kFieldAuthorSteamId: return text(data.authorSteamId);
+    case kFieldDescription: return text(data.description);
+    case kFieldScenarioCount: return std::to_string(data.scenarioCount);
+    case kFieldScenarios: {
+        std::string joined;
+        for (const auto& scenario : data.scenarios) {
+            joined += text(scenario.name) + "=" + std::to_string(scenario.playCount) + ";";
+        }
+        return joined;
+    }
+    case kFieldCount: break;
+    }
+    return {};
+}
+
+// Random playlist documents with a known answer, covering escapes, unicode, odd whitespace,
+// reordered keys, nested decoy keys and non-string values.
+class PlaylistGenerator {
+public:
+    explicit PlaylistGenerator(std::uint64_t seed) : rng_(seed) {}
+
+    std::string next(PlaylistData& expected) {
+        expected = PlaylistData();
+        std::vector<std::string> members;
+        auto addString = [&](const char* key, std::string& slot) {
+            if (chance(10)) return;
+            slot = randomText();
+            members.push_back(quote(key) + space() + ":" + space() + encode(slot));
+        };
+        addString("playlistName", expected.playlistName);
+        addString("shareCode", expected.shareCode);
+        addString("authorName", expected.authorName);
+        addString("authorSteamId", expected.authorSteamId);
+        addString("description", expected.description);
+
+        if (!chance(10)) {
+            std::string list = "[";
+            int count = static_cast<int>(rng_() % 6);
+            for (int i = 0; i < count; ++i) {
+                ScenarioEntry entry;
+                entry.name = randomText();
+                entry.playCount = static_cast<long long>(rng_() % 1000);
+                std::vector<std::string> fields = {
+                    quote("scenario_name") + space() + ":" + space() + encode(entry.name),
+                    quote("play_Count") + space() + ":" + space() + std::to_string(entry.playCount)};
+                if (chance(30)) fields.push_back(quote("description") + ":" + encode(randomText()));
+                shuffle(fields);
+                list += (i ? "," : "") + space() + "{" + join(fields) + "}";
+                expected.scenarios.push_back(std::move(entry));
+            }
+            list += space() + "]";
+            members.push_back(quote("scenarioList") + space() + ":" + space() + list);
+            expected.scenarioCount = count;
+        }
+
+        if (chance(30)) members.push_back(quote("meta") + ":{" + quote("playlistName") + ":" + encode(randomText()) + "}");
+        if (chance(50)) members.push_back(quote("playlistId") + ":" + std::to_string(rng_() % 100000));
+        if (chance(50)) members.push_back(quote("hasEdited") + ":" + (chance(50) ? "true" : "false"));
+        if (chance(20)) members.push_back(quote("tags") + ":[" + encode(randomText()) + ",null,1.5e3]");
+        shuffle(members);
+        return space() + "{" + join(members) + space() + "}" + space();
+    }
+
+    // Truncation, byte flips and byte insertions; the result usually has no well-defined answer.
+    std::string mutate(std::string document) {
+        int edits = 1 + static_cast<int>(rng_() % 3);
+        for (int i = 0; i < edits && !document.empty(); ++i) {
+            std::size_t pos = rng_() % document.size();
+            switch (rng_() % 3) {
+            case 0: document.resize(pos); break;
+            case 1: document[pos] = static_cast<char>(rng_() % 256); break;
+            default: document.insert(pos, 1, "\"\\{}[]:,"[rng_() % 8]); break;
+            }
+        }
+        return document;
+    }
+
+private:
+    bool chance(int percent) { return static_cast<int>(rng_() % 100) < percent; }
+
+    std::string space() {
+        static const char* const kSpaces[] = {"", "", " ", "\n", "\r\n  ", "\t"};
+        return kSpaces[rng_() % 6];
+    }
+
+    std::string randomText() {
+        static const char* const kPieces[] = {"a", "Z", "7", " ", "Kovaak", "\"", "\\", "/", "\n", "\t", "\r\n",
+                                              "\xC3\xA9", "\xE2\x98\x85", "\xF0\x9F\x8E\xAF", "shareCode", ":", ","};
+        std::string text;
+        int pieces = static_cast<int>(rng_() % 8);
+        for (int i = 0; i < pieces; ++i) text += kPieces[rng_() % (sizeof(kPieces) / sizeof(kPieces[0]))];
+        return text;
+    }
+
+    std::string encode(const std::string& text) {
+        std::string out = "\"";
+        for (unsigned char c : text) {
+            if (c == '"') out += "\\\"";
+            else if (c == '\\') out += "\\\\";
+            else if (c == '\n') out += chance(50) ? "\\n" : "\\u000a";
+            else if (c == '\r') out += "\\r";
+            else if (c == '\t') out += "\\t";
+            else if (c == '/' && chance(50)) out += "\\/";
+            else if (c >= 'a' && c <= 'z' && chance(10)) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04X", c);
+                out += hex;
+            } else out += static_cast<char>(c);
+        }
+        return out + "\"";
+    }
+
+    static std::string quote(const char* key) { return std::string("\"") + key + "\""; }
+
+    std::string join(const std::vector<std::string>& parts) {
+        std::string out;
+        for (std::size_t i = 0; i < parts.size(); ++i) out += (i ? "," : "") + space() + parts[i];
+        return out;
+    }
+
+    template <typename T>
+    void shuffle(std::vector<T>& items) {
+        std::shuffle(items.begin(), items.end(), rng_);
+    }
+
+    std::mt19937_64 rng_;
+};
+
+// Keeps each sample on one console line.
+static std::string printable(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else out += c;
+    }
+    return out;
+}
+
+struct DiffReport {
+    long long documents = 0;
+    long long mismatches[sizeof(kDiffBackends) / sizeof(kDiffBackends[0])][kFieldCount] = {};
+    std::vector<std::string> samples;
+};
+
+// Runs every backend on a document with a known answer and records each disagreement.
+static void checkDocument(const std::string& document, const PlaylistData& expected, DiffReport& report) {
+    ++report.documents;
+    for (std::size_t b = 0; b < sizeof(kDiffBackends) / sizeof(kDiffBackends[0]); ++b) {
+        const DiffBackend& backend = kDiffBackends[b];
+        PlaylistData actual;
+        backend.extract(document, actual);
+        for (int f = 0; f < kFieldCount; ++f) {
+            if (!(backend.fields & (1u << f))) continue;
+            std::string want = describeField(expected, static_cast<DiffField>(f), false);
+            std::string got = describeField(actual, static_cast<DiffField>(f), backend.rawStrings);
+            if (want == got) continue;
+            if (report.mismatches[b][f]++ < 3) {
+                report.samples.push_back(std::string(backend.name) + " " + kDiffFieldNames[f] + ": expected [" +
+                                         printable(want) + "] got [" + printable(got) + "] in " +
+                                         printable(document.substr(0, 200)));
+            }
+        }
+    }
+}
+
+// Mutated input has no reference answer; this only proves every backend survives it.
+static void exerciseBackends(const std::string& document) {
+    for (const auto& backend : kDiffBackends) {
+        PlaylistData data;
+        backend.extract(document, data);
+    }
+}
+#endif
+
+#if defined(JSON_PARSER_FUZZ)
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* bytes, std::size_t size) {
+    std::string input(reinterpret_cast<const char*>(bytes), size);
+    exerciseBackends(input);
+
+    // Also treat the input as a generator seed, so the fuzzer reaches deep well-formed documents too.
+    std::uint64_t seed = hashBytes(input);
+    PlaylistGenerator generator(seed);
+    PlaylistData expected;
+    std::string document = generator.next(expected);
+    DiffReport report;
+    checkDocument(document, expected, report);
+#if defined(JSON_PARSER_FUZZ_STRICT)
+    if (!report.samples.empty()) {
+        std::cerr << report.samples.front() << std::endl;
+        std::abort();
+    }
+#endif
+    exerciseBackends(generator.mutate(document));
+    return 0;
+}
+#endif
+
+#if defined(JSON_PARSER_DIFFTEST)
+// Usage: parsejson --difftest [--iterations N] [--seed S] [--baseline FILE] [--write-baseline FILE] [--strict]
+// Exit status is 1 on a throughput regression against the baseline (or on any mismatch with --strict).
+static int runDifferentialTest(int argc, char* argv[]) {
+    long long iterations = 20000;
+    std::uint64_t seed = 1;
+    std::string baselinePath;
+    std::string writeBaselinePath;
+    bool strict = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::atoll(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--write-baseline" && i + 1 < argc) {
+            writeBaselinePath = argv[++i];
+        } else if (arg == "--strict") {
+            strict = true;
+        } else {
+            std::cerr << "Error: Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    PlaylistGenerator generator(seed);
+    DiffReport report;
+    std::vector<std::string> corpus;
+    std::size_t corpusBytes = 0;
+    for (long long i = 0; i < iterations; ++i) {
+        PlaylistData expected;
+        std::string document = generator.next(expected);
+        checkDocument(document, expected, report);
+        exerciseBackends(generator.mutate(document));
+        corpusBytes += document.size();
+        corpus.push_back(std::move(document));
+    }
+
+    std::cout << "=== DIFFERENTIAL CHECK ===" << '\n';
+    std::cout << "Documents: " << report.documents << " (seed " << seed << ")" << '\n';
+    long long totalMismatches = 0;
+    for (std::size_t b = 0; b < sizeof(kDiffBackends) / sizeof(kDiffBackends[0]); ++b) {
+        std::cout << kDiffBackends[b].name << ":";
+        for (int f = 0; f < kFieldCount; ++f) {
+            if (!(kDiffBackends[b].fields & (1u << f))) continue;
+            std::cout << " " << kDiffFieldNames[f] << "=" << report.mismatches[b][f];
+            totalMismatches += report.mismatches[b][f];
+        }
+        std::cout << '\n';
+    }
+    for (const auto& sample : report.samples) {
+        std::cout << "  " << sample << '\n';
+    }
+
+    std::cout << '\n' << "=== THROUGHPUT ===" << '\n';
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty()) {
+        std::ifstream in(baselinePath);
+        std::string name;
+        double mbps;
+        while (in >> name >> mbps) baseline[name] = mbps;
+    }
+    std::ofstream baselineOut;
+    if (!writeBaselinePath.empty()) baselineOut.open(writeBaselinePath);
+
+    bool regressed = false;
+    for (const auto& backend : kDiffBackends) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& document : corpus) {
+            PlaylistData data;
+            backend.extract(document, data);
+        }
+        double seconds = millisecondsSince(start) / 1000.0;
+        double mbps = seconds > 0.0 ? corpusBytes / (1024.0 * 1024.0) / seconds : 0.0;
+        std::cout << backend.name << ": " << mbps << " MiB/s";
+        auto found = baseline.find(backend.name);
+        if (found != baseline.end()) {
+            // 20% slack absorbs normal run-to-run noise.
+            bool slower = mbps < found->second * 0.8;
+            regressed = regressed || slower;
+            std::cout << " (baseline " << found->second << (slower ? " MiB/s, REGRESSION)" : " MiB/s)");
+        }
+        std::cout << '\n';
+        if (baselineOut) baselineOut << backend.name << " " << mbps << '\n';
+    }
+
+    // Cost of the --fields matcher as the selection grows; the 20-field table includes names
+    // that never occur, which is the common case for user-supplied lists.
+    std::vector<std::string> selection = {"playlistName", "shareCode", "authorName", "authorSteamId", "description",
+                                          "scenarioList", "playlistId", "hasEdited", "tags", "meta", "version"};
+    for (int extra = 0; selection.size() < 20; ++extra) selection.push_back("missingField" + std::to_string(extra));
+    std::vector<std::pair<std::string, std::vector<std::string>>> tables;
+    for (std::size_t count : {2u, 5u, 20u}) {
+        tables.emplace_back("fields-" + std::to_string(count),
+                            std::vector<std::string>(selection.begin(), selection.begin() + count));
+    }
+    // Nested JSON Pointers versus a plain skipValue pass over the whole document.
+    tables.emplace_back("pointer-nested",
+                        std::vector<std::string>{"/scenarioList/2/scenario_name", "/meta/playlistName", "/tags/0"});
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& document : corpus) {
+            std::size_t pos = 0;
+            skipValue(document, pos);
+        }
+        double seconds = millisecondsSince(start) / 1000.0;
+        std::cout << "raw-scan: " << (seconds > 0.0 ? corpusBytes / (1024.0 * 1024.0) / seconds : 0.0) << " MiB/s" << '\n';
+    }
+    for (const auto& [name, names] : tables) {
+        FieldTable table = FieldTable::compile(names, false, false, false);
+        std::vector<std::string_view> values;
+        FieldSlots slots;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& document : corpus) {
+            extractFieldValues(document, table, values);
+            packFieldSlots(values, slots);
+        }
+        double seconds = millisecondsSince(start) / 1000.0;
+        double mbps = seconds > 0.0 ? corpusBytes / (1024.0 * 1024.0) / seconds : 0.0;
+        std::cout << name << ": " << mbps << " MiB/s";
+        auto found = baseline.find(name);
+        if (found != baseline.end()) {
+            bool slower = mbps < found->second * 0.8;
+            regressed = regressed || slower;
+            std::cout << " (baseline " << found->second << (slower ? " MiB/s, REGRESSION)" : " MiB/s)");
+        }
+        std::cout << '\n';
+        if (baselineOut) baselineOut << name << " " << mbps << '\n';
+    }
+
+    if (regressed) return 1;
+    if (strict && totalMismatches > 0) return 1;
+    return 0;
+}
+#endif
+
+#if defined(JSON_PARSER_DIFFTEST)
+// ---- Microbenchmarks for the concurrency building blocks and the output path ----
+
+// The obvious alternative to MpmcRing, for comparison.
+template <typename T>
+class MutexQueue {
+public:
+    bool tryEnqueue(const T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.push_back(value);
+        return true;
+    }
+
+    std::size_t tryDequeueBatch(T* out, std::size_t maxItems) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::size_t count = std::min(maxItems, items_.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] = items_.front();
+            items_.pop_front();
+        }
+        return count;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<T> items_;
+};
+
+// Half the threads produce `items` values between them, the other half consume in batches.
+// Returns millions of items handed over per second.
+template <typename Queue>
+static double queueThroughput(Queue& queue, std::size_t threads, std::size_t batch, std::size_t items) {
+    std::size_t producers = std::max<std::size_t>(1, threads / 2);
+    std::size_t consumers = std::max<std::size_t>(1, threads - producers);
+    std::atomic<std::size_t> consumed{0};
+    std::atomic<std::uint64_t> checksum{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (std::size_t p = 0; p < producers; ++p) {
+        workers.emplace_back([&, p] {
+            for (std::size_t i = p; i < items; i += producers) {
+                while (!queue.tryEnqueue(static_cast<std::uint32_t>(i))) std::this_thread::yield();
+            }
+        });
+    }
+    for (std::size_t c = 0; c < consumers; ++c) {
+        workers.emplace_back([&] {
+            std::vector<std::uint32_t> out(batch);
+            std::uint64_t sum = 0;
+            while (consumed.load(std::memory_order_relaxed) < items) {
+                std::size_t count = queue.tryDequeueBatch(out.data(), batch);
+                if (count == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (std::size_t i = 0; i < count; ++i) sum += out[i];
+                consumed.fetch_add(count, std::memory_order_relaxed);
+            }
+            checksum.fetch_add(sum);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = millisecondsSince(start) / 1000.0;
+    std::uint64_t expected = static_cast<std::uint64_t>(items) * (items - 1) / 2;
+    if (checksum.load() != expected) {
+        std::cout << "  [ERROR] lost or duplicated items" << '\n';
+    }
+    return seconds > 0.0 ? items / seconds / 1e6 : 0.0;
+}
+
+// Read + parse throughput of the scan pipeline over a real folder (warm cache, no console
+// output) at 1..all hardware threads, unpinned and pinned.
+static void scalingCurve(const std::string& folderPath, std::size_t maxThreads) {
+    std::vector<std::string> names = listJsonFiles(folderPath, true);
+    static const FieldTable table = FieldTable::compile({"playlistName", "shareCode"}, false, false, false);
+    ParseFileFn parse = [](const std::string&, const std::string& content, const FileStamp&) {
+        PlaylistData data;
+        std::vector<std::string_view> values;
+        extractFieldValues(content, table, values);
+        data.playlistName = values[table.playlistNameSlot];
+        data.shareCode = values[table.shareCodeSlot];
+        extractScenarios(content, data.scenarios);
+        return data;
+    };
+    auto noClaim = [](std::size_t) {};
+    auto discard = [](std::size_t, PlaylistData&) {};
+    readAndParsePipelined(folderPath, names, 2, nullptr, false, false, noClaim, parse, discard);  // warm the page cache
+
+    const CpuTopology& topology = CpuTopology::get();
+    std::size_t cores = 0;
+    for (const auto& cpus : topology.nodeCpus) cores += cpus.size();
+    std::cout << "=== SCALING (" << names.size() << " files, " << cores << " cores on " << topology.nodeCpus.size()
+              << " NUMA node(s)) ===" << '\n';
+    std::cout << "workers  files/s  speedup  pinned files/s  pinned speedup" << '\n';
+    std::vector<std::size_t> counts;
+    for (std::size_t workers = 1; workers < std::min(cores, maxThreads); workers *= 2) counts.push_back(workers);
+    counts.push_back(std::min(cores, maxThreads));
+    double base[2] = {0.0, 0.0};
+    for (std::size_t workers : counts) {
+        std::cout << workers;
+        for (int pinned = 0; pinned < 2; ++pinned) {
+            CpuAllocator cpus;
+            auto start = std::chrono::steady_clock::now();
+            readAndParsePipelined(folderPath, names, workers, pinned == 1 ? &cpus : nullptr, false, false, noClaim, parse,
+                                  discard);
+            double seconds = millisecondsSince(start) / 1000.0;
+            double rate = seconds > 0.0 ? names.size() / seconds : 0.0;
+            if (base[pinned] == 0.0) base[pinned] = rate;
+            std::cout << "  " << static_cast<long long>(rate) << "  " << (base[pinned] > 0.0 ? rate / base[pinned] : 0.0);
+        }
+        std::cout << '\n';
+    }
+}
+
+// Records shaped like a real library: every field present, descriptions of varying length.
+static std::vector<PlaylistData> syntheticResults(std::size_t count) {
+    std::vector<PlaylistData> results(count);
+    std::mt19937_64 random(1);
+    for (std::size_t i = 0; i < count; ++i) {
+        PlaylistData& data = results[i];
+        data.playlistName = "Tracking Benchmark " + std::to_string(i);
+        data.shareCode = "KovaaKs" + std::to_string(random() % 1000000000000ull);
+        data.authorName = "Author" + std::to_string(random() % 5000);
+        data.authorSteamId = std::to_string(76561190000000000ull + random() % 10000000000ull);
+        data.description = std::string(20 + random() % 120, 'd');
+    }
+    return results;
+}
+
+// The stream-based writers formatResults replaced, for comparison: the original per-line
+// std::endl version, and the ostringstream with '\n' that came between them.
+static void formatWithOstream(std::ostream& out, const std::vector<PlaylistData>& results, bool flushLines) {
+    for (const auto& result : results) {
+        out << "Playlist Name: " << (result.playlistName.empty() ? "(not found)" : result.playlistName) << '\n';
+        if (flushLines) out.flush();
+        out << "Share Code: " << (result.shareCode.empty() ? "(not found)" : result.shareCode) << '\n';
+        if (flushLines) out.flush();
+        if (!result.authorName.empty() && !result.authorSteamId.empty()) {
+            out << "Author: " << result.authorName << " SID: " << result.authorSteamId << '\n';
+            if (flushLines) out.flush();
+        }
+        if (!result.description.empty()) {
+            out << "Description: " << result.description << '\n';
+            if (flushLines) out.flush();
+        }
+        out << '\n';
+        if (flushLines) out.flush();
+    }
+}
+
+// Scenario lists drawn from a shared pool of names, a third of them edited copies of an earlier
+// list, so LSH buckets fill the way a real library's do (near-duplicates, popular scenarios).
+static std::vector<PlaylistData> syntheticSignatures(std::size_t count) {
+    std::vector<PlaylistData> results(count);
+    std::vector<std::vector<ScenarioEntry>> lists(count);
+    std::mt19937_64 random(1);
+    constexpr std::size_t kScenarioPool = 50000;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::vector<ScenarioEntry>& scenarios = lists[i];
+        if (i > 0 && random() % 3 == 0) {
+            scenarios = lists[random() % i];
+            if (!scenarios.empty()) {
+                scenarios[random() % scenarios.size()].name = "Scenario " + std::to_string(random() % kScenarioPool);
+            }
+        } else {
+            std::size_t length = 5 + random() % 26;
+            for (std::size_t k = 0; k < length; ++k) {
+                // Squaring skews picks toward the low, "popular" end of the pool.
+                std::uint64_t pick = random() % kScenarioPool;
+                scenarios.push_back(ScenarioEntry{"Scenario " + std::to_string(pick * pick / kScenarioPool), 0});
+            }
+        }
+        results[i].minHash = computeMinHash(scenarios);
+    }
+    return results;
+}
+
+// Scan time for 1, 2, 4, ... roots of `filesPerRoot` generated playlists each, scanned the way
+// runScan does it: one scanner thread per root, --jobs split between them, one shared tracker.
+// A tenth of each root's share codes also appear in the root before it.
+static void rootScaling(std::size_t maxRoots, std::size_t filesPerRoot) {
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_roots";
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    for (std::size_t root = 0; root < maxRoots; ++root) {
+        fs::path folder = base / ("root" + std::to_string(root));
+        fs::create_directories(folder);
+        for (std::size_t i = 0; i < filesPerRoot; ++i) {
+            bool shared = root > 0 && i % 10 == 0 && i + 1 < filesPerRoot;
+            std::size_t code = shared ? (root - 1) * filesPerRoot + i + 1 : root * filesPerRoot + i;
+            std::ofstream file(folder / (std::to_string(i) + ".json"), std::ios::binary);
+            file << "{\"playlistName\": \"Playlist " << root << "-" << i << "\", \"authorName\": \"Author\", "
+                 << "\"scenarioList\": [";
+            for (int k = 0; k < 10; ++k) {
+                file << (k ? ", " : "") << "{\"scenario_name\": \"Scenario " << (i + k) % 500 << "\", \"play_Count\": 1}";
+            }
+            file << "], \"description\": \"Generated\", \"shareCode\": \"KovaaKsBench" << code << "\"}";
+        }
+    }
+
+    std::ostringstream discard;
+    std::ostream* previous = reportStream;
+    reportStream = &discard;
+    ScanOptions options;
+    std::cout << "=== ROOT SCALING (" << filesPerRoot << " files per root, " << options.jobs << " jobs) ===" << '\n';
+    std::cout << "roots  files  ms  files/s  cross-root duplicates" << '\n';
+    for (std::size_t roots = 1; roots <= maxRoots; roots *= 2) {
+        DuplicateTracker tracker;
+        std::vector<std::vector<PlaylistData>> results(roots);
+        std::vector<CanonicalGroups> groups(roots);
+        std::vector<ScenarioCounts> scenarioCounts(roots);
+        std::vector<RootStats> stats(roots);
+        std::vector<int> duplicateNames(roots, 0);
+        std::size_t workersPerRoot = std::max<std::size_t>(1, options.jobs / roots);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> scanners;
+        for (std::size_t i = 0; i < roots; ++i) {
+            scanners.emplace_back([&, i] {
+                scanRoot(i, (base / ("root" + std::to_string(i))).string(), options, workersPerRoot, tracker, results[i],
+                         groups[i], scenarioCounts[i], nullptr, nullptr, stats[i], duplicateNames[i]);
+            });
+        }
+        for (auto& scanner : scanners) scanner.join();
+        double ms = millisecondsSince(start);
+        std::size_t duplicates = 0;
+        tracker.shareCodeRoots.forEach([&duplicates](const std::string&, const std::vector<std::size_t>& copies) {
+            if (copies.size() > 1) ++duplicates;
+        });
+        std::size_t files = roots * filesPerRoot;
+        std::cout << roots << "  " << files << "  " << ms << "  "
+                  << static_cast<long long>(ms > 0.0 ? files / (ms / 1000.0) : 0.0) << "  " << duplicates << '\n';
+        discard.str(std::string());
+    }
+    reportStream = previous;
+    fs::remove_all(base, ec);
+}
+
+// One root of `playlists` generated files with 30 scenarios each, drawn from a pool of 5000 names
+// skewed toward popular ones, scanned with and without --scenario-stats (warm cache, same jobs),
+// then the ranking for the two top-K tables timed on its own. The counts are checked against
+// what was generated.
+static void scenarioStatsCost(std::size_t playlists) {
+    constexpr std::size_t kScenariosPerPlaylist = 30;
+    constexpr std::uint64_t kScenarioPool = 5000;
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_scenarios";
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    fs::create_directories(base);
+    std::mt19937_64 random(1);
+    long long expectedPlays = 0;
+    long long expectedMemberships = 0;
+    for (std::size_t i = 0; i < playlists; ++i) {
+        std::ofstream file(base / (std::to_string(i) + ".json"), std::ios::binary);
+        file << "{\"playlistName\": \"Playlist " << i << "\", \"authorName\": \"Author\", \"scenarioList\": [";
+        std::set<std::uint64_t> members;
+        for (std::size_t k = 0; k < kScenariosPerPlaylist; ++k) {
+            std::uint64_t pick = random() % kScenarioPool;
+            pick = pick * pick / kScenarioPool;
+            long long plays = static_cast<long long>(random() % 1000);
+            expectedPlays += plays;
+            members.insert(pick);
+            file << (k ? ", " : "") << "{\"scenario_name\": \"Scenario " << pick << "\", \"play_Count\": " << plays << "}";
+        }
+        expectedMemberships += static_cast<long long>(members.size());
+        file << "], \"description\": \"Generated\", \"shareCode\": \"KovaaKsBench" << i << "\"}";
+    }
+
+    std::ostringstream discard;
+    std::ostream* previous = reportStream;
+    reportStream = &discard;
+    ScanOptions options;
+    std::cout << "=== SCENARIO STATS (" << playlists << " playlists x " << kScenariosPerPlaylist << " scenarios, "
+              << options.jobs << " jobs) ===" << '\n';
+    ScenarioCounts counts;
+    // The first pass only warms the page cache.
+    for (int pass = 0; pass < 3; ++pass) {
+        options.scenarioStats = pass == 2;
+        DuplicateTracker tracker;
+        std::vector<PlaylistData> results;
+        CanonicalGroups groups;
+        RootStats stats;
+        int duplicateNames = 0;
+        counts.clear();
+        auto start = std::chrono::steady_clock::now();
+        scanRoot(0, base.string(), options, options.jobs, tracker, results, groups, counts, nullptr, nullptr, stats,
+                 duplicateNames);
+        double ms = millisecondsSince(start);
+        if (pass > 0) {
+            std::cout << (options.scenarioStats ? "scan, --scenario-stats  " : "scan                    ") << ms << " ms"
+                      << '\n';
+        }
+        discard.str(std::string());
+    }
+    reportStream = previous;
+
+    long long plays = 0;
+    long long memberships = 0;
+    for (const auto& [name, totals] : counts) {
+        plays += totals.playCountSum;
+        memberships += totals.playlistCount;
+    }
+    if (plays != expectedPlays || memberships != expectedMemberships) {
+        std::cout << "  [ERROR] counted " << memberships << " memberships and " << plays << " plays, expected "
+                  << expectedMemberships << " and " << expectedPlays << '\n';
+    }
+
+    std::streambuf* console = std::cout.rdbuf(discard.rdbuf());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::pair<std::string, ScenarioTotals>> ranked(counts.begin(), counts.end());
+    printTopScenarios(ranked, options.topK, false);
+    printTopScenarios(ranked, options.topK, true);
+    double rankMs = millisecondsSince(start);
+    std::cout.rdbuf(console);
+    std::cout << "top-" << options.topK << " tables          " << rankMs << " ms (" << counts.size() << " distinct scenarios)"
+              << '\n';
+    fs::remove_all(base, ec);
+}
+
+// Whole-process cost of a one-shot run over a 200-file folder (the double-click case): `runs`
+// launches of `program` (and of `baseline`, an older build, when given) with -a, warm cache. Wall
+// time is taken here; startup, time to first file and scan time come from each run's statistics,
+// so a build without the startup breakdown shows "-" for those.
+static void startupCost(const std::string& program, const std::string& baseline, std::size_t runs) {
+    constexpr std::size_t kFiles = 200;
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_startup";
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    fs::path folder = base / "Playlists";
+    fs::create_directories(folder);
+    for (std::size_t i = 0; i < kFiles; ++i) {
+        std::ofstream file(folder / (std::to_string(i) + ".json"), std::ios::binary);
+        file << "{\"playlistName\": \"Playlist " << i << "\", \"authorName\": \"Author\", "
+             << "\"authorSteamId\": \"76561190000000000\", \"scenarioList\": [";
+        for (int k = 0; k < 10; ++k) {
+            file << (k ? ", " : "") << "{\"scenario_name\": \"Scenario " << (i + k) % 500 << "\", \"play_Count\": 1}";
+        }
+        file << "], \"description\": \"Generated\", \"shareCode\": \"KovaaKsBench" << i << "\"}";
+    }
+    fs::path log = base / "run.log";
+
+    // The number after `label` on the first line containing it, or -1.
+    auto statistic = [](const std::string& text, const std::string& label) {
+        std::size_t at = text.find(label);
+        return at == std::string::npos ? -1.0 : std::atof(text.c_str() + at + label.size());
+    };
+    auto measure = [&](const std::string& exe) {
+        std::string command = "\"" + exe + "\" \"" + folder.string() + "\" -a -o \"" + base.string() + "\" > \"" +
+                              log.string() + "\" 2>&1";
+#if defined(_WIN32)
+        // cmd.exe strips the outer pair of quotes when the line starts with one.
+        command = "\"" + command + "\"";
+#endif
+        double sums[4] = {0.0, 0.0, 0.0, 0.0};
+        int seen[4] = {0, 0, 0, 0};
+        double fastest = 0.0;
+        for (std::size_t run = 0; run < runs; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            int status = std::system(command.c_str());
+            double wallMs = millisecondsSince(start);
+            if (status != 0) {
+                std::cout << "  [ERROR] " << exe << " exited with status " << status << '\n';
+                return;
+            }
+            std::ifstream in(log, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            double values[4] = {wallMs, statistic(text, "Startup: "), statistic(text, "Time to first file: "),
+                                statistic(text, "Scan time: ")};
+            for (int i = 0; i < 4; ++i) {
+                if (values[i] < 0.0) continue;
+                sums[i] += values[i];
+                ++seen[i];
+            }
+            fastest = run == 0 ? wallMs : std::min(fastest, wallMs);
+        }
+        std::cout << exe << '\n' << "  wall " << sums[0] / runs << " ms (fastest " << fastest << ")";
+        const char* labels[4] = {"", ", startup ", ", first file ", ", scan "};
+        for (int i = 1; i < 4; ++i) {
+            std::cout << labels[i];
+            if (seen[i] > 0) {
+                std::cout << sums[i] / seen[i] << " ms";
+            } else {
+                std::cout << "-";
+            }
+        }
+        std::cout << '\n';
+    };
+
+    std::cout << "=== STARTUP (" << kFiles << "-file folder, -a, mean of " << runs << " runs) ===" << '\n';
+    if (!baseline.empty()) measure(baseline);
+    measure(program);
 
-struct PlaylistData {
-    std::string playlistName;
-    std::string shareCode;
-    std::string authorName;
-    std::string authorSteamId;
-    std::string description;
-};
+    // What the first parseJsonFile call used to pay on every run; now only the regex fallback does.
+    auto start = std::chrono::steady_clock::now();
+    for (const char* field : {"playlistName", "shareCode", "authorName", "authorSteamId", "description"}) {
+        std::regex pattern("\"" + std::string(field) + "\"\\s*:\\s*\"([^\"]*)\"");
+    }
+    std::cout << "fallback regex construction  " << millisecondsSince(start) << " ms (now deferred until first used)"
+              << '\n';
+    fs::remove_all(base, ec);
+}
+
+// Enumeration of one directory of `entries` entries, warm cache, best of three: getdents64 with
+// d_type filtering against the std::filesystem loop. One entry in twenty is a .txt file and one a
+// directory named like a playlist, so both filters do real work; the two lists must match.
+static void enumerationCost(std::size_t entries) {
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_enumerate";
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    fs::create_directories(base);
+    std::size_t expected = 0;
+    for (std::size_t i = 0; i < entries; ++i) {
+        std::string name = std::to_string(i);
+        if (i % 20 == 0) {
+            fs::create_directory(base / (name + ".json"));
+        } else if (i % 20 == 1) {
+            std::ofstream(base / (name + ".txt"));
+        } else {
+            std::ofstream(base / (name + ".json"));
+            ++expected;
+        }
+    }
 
-static std::string readFileToString(const std::string& path) {
+    std::cout << "=== ENUMERATION (" << entries << " entries, " << expected << " playlists, best of 3) ===" << '\n';
+    auto best = [&base](const std::function<std::vector<std::string>(const std::string&)>& list,
+                        std::vector<std::string>& names) {
+        double fastest = 0.0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            names = list(base.string());
+            double ms = millisecondsSince(start);
+            fastest = run == 0 ? ms : std::min(fastest, ms);
+        }
+        return fastest;
+    };
+    std::vector<std::string> portable;
+    std::cout << "std::filesystem  " << best(listJsonFilesPortable, portable) << " ms" << '\n';
+#if defined(HAVE_GETDENTS64)
+    std::vector<std::string> raw;
+    std::cout << "getdents64       "
+              << best([](const std::string& folder) { return listJsonFiles(folder, false); }, raw) << " ms" << '\n';
+    if (raw != portable) std::cout << "  [ERROR] the two enumerators listed different files" << '\n';
+#else
+    std::cout << "getdents64       (not in this build)" << '\n';
+#endif
+    if (portable.size() != expected) {
+        std::cout << "  [ERROR] listed " << portable.size() << " playlists, expected " << expected << '\n';
+    }
+    fs::remove_all(base, ec);
+}
+
+#if defined(__linux__)
+// System calls made by `work`, counted the way strace does: `work` runs in a forked child that
+// stops at every syscall entry and exit. -1 if tracing is not permitted (some containers forbid it).
+static long long countSyscalls(const std::function<void()>& work) {
+    pid_t child = ::fork();
+    if (child < 0) return -1;
+    if (child == 0) {
+        if (::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) ::_exit(2);
+        ::raise(SIGSTOP);
+        work();
+        ::_exit(0);
+    }
+    int status = 0;
+    if (::waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status)) {
+        ::waitpid(child, &status, 0);
+        return -1;
+    }
+    ::ptrace(PTRACE_SETOPTIONS, child, nullptr, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+    long long stops = 0;
+    int signal = 0;
+    while (::ptrace(PTRACE_SYSCALL, child, nullptr, signal) == 0 && ::waitpid(child, &status, 0) >= 0) {
+        if (WIFEXITED(status) || WIFSIGNALED(status)) break;
+        signal = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            ++stops;
+        } else {
+            signal = WSTOPSIG(status);
+        }
+    }
+    // exit_group stops on entry only.
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? (stops + 1) / 2 : -1;
+}
+#endif
+
+// The reader DirectoryReader replaced: a full path per file, streamed through ifstream and an
+// ostringstream.
+static std::string readViaStream(const std::string& path) {
     std::ifstream ifs(path);
     if (!ifs) return {};
     std::ostringstream ss;
@@ -36,115 +4844,742 @@ static std::string readFileToString(const std::string& path) {
     return ss.str();
 }
 
-static PlaylistData parseJsonFile(const std::string& filepath, bool includeAuthor, bool includeDescription) {
-    std::string content = readFileToString(filepath);
-    PlaylistData data;
-    if (content.empty()) {
-        std::cerr << "Failed to open or empty file: " << filepath << std::endl;
-        return data;
+// Per-file cost of reading `files` playlists that sit 30 directories deep (warm cache, best of 3):
+// the old full-path stream reader against DirectoryReader. Syscalls are counted on Linux over the
+// first 2000 files, less a run that reads none, so process start and exit do not count.
+static void deepPathCost(std::size_t files) {
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_deep";
+    std::error_code ec;
+    fs::remove_all(base, ec);
+    fs::path folder = base;
+    for (int level = 0; level < 30; ++level) folder /= "level" + std::to_string(level);
+    fs::create_directories(folder);
+    std::vector<std::string> names;
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; i < files; ++i) {
+        names.push_back(std::to_string(i) + ".json");
+        std::ofstream file(folder / names.back(), std::ios::binary);
+        std::string text = "{\"playlistName\": \"Playlist " + std::to_string(i) + "\", \"description\": \"" +
+                           std::string(200 + i % 400, 'd') + "\", \"shareCode\": \"KovaaKsBench" + std::to_string(i) + "\"}";
+        bytes += text.size();
+        file << text;
     }
+    std::string folderPath = folder.string();
 
-#if defined(HAVE_NLOHMANN_JSON)
-    try {
-        auto j = json::parse(content);
-        if (j.contains("playlistName") && j["playlistName"].is_string())
-            data.playlistName = j["playlistName"].get<std::string>();
-        if (j.contains("shareCode") && j["shareCode"].is_string())
-            data.shareCode = j["shareCode"].get<std::string>();
-        if (includeAuthor) {
-            if (j.contains("authorName") && j["authorName"].is_string())
-                data.authorName = j["authorName"].get<std::string>();
-            if (j.contains("authorSteamId") && j["authorSteamId"].is_string())
-                data.authorSteamId = j["authorSteamId"].get<std::string>();
+    auto viaStream = [&](std::size_t count) {
+        std::size_t read = 0;
+        for (std::size_t i = 0; i < count; ++i) read += readViaStream((fs::path(folderPath) / names[i]).string()).size();
+        return read;
+    };
+    auto viaReader = [&](std::size_t count) {
+        DirectoryReader reader(folderPath);
+        std::string content;
+        std::size_t read = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            reader.read(names[i], content, nullptr);
+            read += content.size();
         }
-        if (includeDescription) {
-            if (j.contains("description") && j["description"].is_string())
-                data.description = j["description"].get<std::string>();
+        return read;
+    };
+
+    std::cout << "=== DEEP PATHS (" << files << " files, " << folderPath.size() << "-byte directory path) ===" << '\n';
+    std::cout << "reader  us/file  syscalls/file" << '\n';
+    std::function<std::size_t(std::size_t)> readers[2] = {viaStream, viaReader};
+    for (int which = 0; which < 2; ++which) {
+        const auto& readFiles = readers[which];
+        double fastest = 0.0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            std::size_t read = readFiles(files);
+            double ms = millisecondsSince(start);
+            fastest = run == 0 ? ms : std::min(fastest, ms);
+            if (read != bytes) std::cout << "  [ERROR] read " << read << " bytes, expected " << bytes << '\n';
+        }
+        std::cout << (which == 0 ? "ifstream + ostringstream, full path  " : "DirectoryReader                      ")
+                  << fastest * 1000.0 / files;
+#if defined(__linux__)
+        std::size_t counted = std::min<std::size_t>(files, 2000);
+        long long none = countSyscalls([&] { readFiles(0); });
+        long long all = countSyscalls([&] { readFiles(counted); });
+        if (none >= 0 && all >= 0) {
+            std::cout << "  " << static_cast<double>(all - none) / counted;
+        } else {
+            std::cout << "  (tracing not permitted)";
         }
-    } catch (const std::exception&) {
-        // fall back to regex below
-    }
 #endif
+        std::cout << '\n';
+    }
+    fs::remove_all(base, ec);
+}
 
-    if (data.playlistName.empty() || data.shareCode.empty() || 
-        (includeAuthor && (data.authorName.empty() || data.authorSteamId.empty())) ||
-        (includeDescription && data.description.empty())) {
-        std::regex playlistPattern("\"playlistName\"\\s*:\\s*\"([^\"]*)\"");
-        std::regex shareCodePattern("\"shareCode\"\\s*:\\s*\"([^\"]*)\"");
-        std::smatch match;
-        if (std::regex_search(content, match, playlistPattern))
-            data.playlistName = match[1].str();
-        if (std::regex_search(content, match, shareCodePattern))
-            data.shareCode = match[1].str();
-        if (includeAuthor) {
-            std::regex authorNamePattern("\"authorName\"\\s*:\\s*\"([^\"]*)\"");
-            std::regex authorSteamIdPattern("\"authorSteamId\"\\s*:\\s*\"([^\"]*)\"");
-            if (std::regex_search(content, match, authorNamePattern))
-                data.authorName = match[1].str();
-            if (std::regex_search(content, match, authorSteamIdPattern))
-                data.authorSteamId = match[1].str();
+// Watch-mode rescans of `files` playlists while an editor keeps saving the same few: before each of
+// 20 cycles, 5 saves land on files drawn from a hot set of 20. Each cycle is scanned with no
+// cache, with the default 64 MB budget, and with half the memory the full cache ended up using.
+// Every configuration must produce the same records as the uncached one, cycle by cycle.
+static void cacheCost(std::size_t files) {
+    constexpr int kCycles = 20;
+    constexpr std::size_t kHotFiles = 20;
+    constexpr std::size_t kSavesPerCycle = 5;
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_cache";
+    auto writePlaylist = [&base](std::size_t i, std::uint64_t plays) {
+        std::ofstream file(base / (std::to_string(i) + ".json"), std::ios::binary | std::ios::trunc);
+        file << "{\"playlistName\": \"Playlist " << i << "\", \"authorName\": \"Author\", "
+             << "\"authorSteamId\": \"76561190000000000\", \"scenarioList\": [";
+        for (int k = 0; k < 30; ++k) {
+            file << (k ? ", " : "") << "{\"scenario_name\": \"Scenario " << (i + k) % 500 << "\", \"play_Count\": "
+                 << plays + k << "}";
         }
-        if (includeDescription) {
-            std::regex descriptionPattern("\"description\"\\s*:\\s*\"([^\"]*)\"");
-            if (std::regex_search(content, match, descriptionPattern))
-                data.description = match[1].str();
+        file << "], \"description\": \"" << std::string(100 + i % 200, 'd') << "\", \"shareCode\": \"KovaaKsBench" << i
+             << "\"}";
+    };
+
+    std::ostringstream discard;
+    std::ostream* previous = reportStream;
+    reportStream = &discard;
+    ScanOptions options;
+    options.includeAuthor = true;
+    options.includeDescription = true;
+    struct Outcome {
+        double cycleMs = 0.0;
+        std::vector<std::uint64_t> digests;
+    };
+    auto run = [&](ParseCache* cache) {
+        std::error_code ec;
+        fs::remove_all(base, ec);
+        fs::create_directories(base);
+        for (std::size_t i = 0; i < files; ++i) writePlaylist(i, 0);
+        std::mt19937_64 random(1);
+        Outcome outcome;
+        for (int cycle = 0; cycle < kCycles; ++cycle) {
+            if (cycle > 0) {
+                for (std::size_t save = 0; save < kSavesPerCycle; ++save) {
+                    writePlaylist(random() % std::min(kHotFiles, files), static_cast<std::uint64_t>(cycle) * 100 + save);
+                }
+            }
+            DuplicateTracker tracker;
+            std::vector<PlaylistData> results;
+            CanonicalGroups groups;
+            ScenarioCounts counts;
+            RootStats stats;
+            int duplicateNames = 0;
+            auto start = std::chrono::steady_clock::now();
+            scanRoot(0, base.string(), options, options.jobs, tracker, results, groups, counts, cache, nullptr, stats,
+                     duplicateNames);
+            // The first cycle fills the cache; only the rescans after it are timed.
+            if (cycle > 0) outcome.cycleMs += millisecondsSince(start) / (kCycles - 1);
+            // Each configuration recreates the files, so inode (and therefore scan) order differs.
+            std::sort(results.begin(), results.end(),
+                      [](const PlaylistData& a, const PlaylistData& b) { return a.shareCode < b.shareCode; });
+            std::string all;
+            for (const auto& data : results) all += data.playlistName + '\n' + data.shareCode + '\n' + data.description + '\n';
+            outcome.digests.push_back(hashBytes(all));
+            discard.str(std::string());
+        }
+        return outcome;
+    };
+
+    std::cout << "=== WATCH CACHE (" << files << " files, " << kCycles << " cycles, " << kSavesPerCycle
+              << " saves per cycle to " << kHotFiles << " hot files) ===" << '\n';
+    std::cout << "cache  ms/rescan  hits  misses  evictions  MB used" << '\n';
+    Outcome uncached = run(nullptr);
+    std::cout << "none   " << uncached.cycleMs << '\n';
+    std::size_t fullBytes = 0;
+    for (int half = 0; half < 2; ++half) {
+        ParseCache cache;
+        cache.budgetBytes = half ? fullBytes / 2 : std::size_t{64} * 1024 * 1024;
+        Outcome cached = run(&cache);
+        if (!half) fullBytes = cache.usedBytes;
+        std::cout << (half ? "half   " : "64 MB  ") << cached.cycleMs << "  " << cache.hits << "  " << cache.misses << "  "
+                  << cache.evictions << "  " << cache.usedBytes / (1024.0 * 1024.0) << '\n';
+        if (cached.digests != uncached.digests) {
+            std::cout << "  [ERROR] cached scans produced different records" << '\n';
         }
     }
+    reportStream = previous;
+    std::error_code ec;
+    fs::remove_all(base, ec);
+}
 
-    std::cout << "File: " << fs::path(filepath).filename().string() << std::endl;
-    std::cout << "  playlistName: " << (data.playlistName.empty() ? "(not found)" : data.playlistName) << std::endl;
-    std::cout << "  shareCode: " << (data.shareCode.empty() ? "(not found)" : data.shareCode) << std::endl;
-    if (includeAuthor) {
-        std::cout << "  authorName: " << (data.authorName.empty() ? "(not found)" : data.authorName) << std::endl;
-        std::cout << "  authorSteamId: " << (data.authorSteamId.empty() ? "(not found)" : data.authorSteamId) << std::endl;
+#if defined(HAVE_FADVISE)
+// What the readahead hinter costs and buys, reading files the way scanRoot's serial path does, at
+// 300 files and at `files`; each figure is the min-max of 5 runs. Warm: everything cached, hinter
+// off and on, in inode order. Cold: each file's pages dropped with FADV_DONTNEED first, then
+// directory order, inode order, and inode order with hints. Dropping pages does not evict
+// inodes or dentries, and a VM's host may still cache the disk, so "cold" is a lower bound.
+static void readaheadCost(std::size_t files) {
+    fs::path base = fs::temp_directory_path() / "parsejson_bench_readahead";
+    std::vector<std::size_t> sizes = {300};
+    if (files > 300) sizes.push_back(files);
+    std::cout << "=== READAHEAD HINTS (ms, min-max of 5 runs) ===" << '\n';
+    std::cout << "files  warm, no hints  warm, hinted  cold, directory order  cold, inode order  cold, inode order + hints"
+              << '\n';
+    for (std::size_t size : sizes) {
+        std::error_code ec;
+        fs::remove_all(base, ec);
+        fs::create_directories(base);
+        for (std::size_t i = 0; i < size; ++i) {
+            std::ofstream file(base / (std::to_string(i) + ".json"), std::ios::binary);
+            file << "{\"playlistName\": \"Playlist " << i << "\", \"description\": \"" << std::string(1000 + i % 1000, 'd')
+                 << "\", \"shareCode\": \"KovaaKsBench" << i << "\"}";
+        }
+        std::string folderPath = base.string();
+        std::vector<std::string> directoryOrder = listJsonFiles(folderPath, false);
+        std::vector<std::string> inodeOrder = listJsonFiles(folderPath, true);
+
+        // Freshly written pages are dirty, and FADV_DONTNEED skips dirty pages, so flush them first.
+        auto dropPages = [&] {
+            for (const auto& name : directoryOrder) {
+                int fd = ::open((base / name).c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) continue;
+                ::fdatasync(fd);
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                ::close(fd);
+            }
+        };
+        auto readAll = [&](const std::vector<std::string>& names, bool hinted) {
+            auto start = std::chrono::steady_clock::now();
+            DirectoryReader reader(folderPath);
+            std::unique_ptr<ReadaheadHinter> hinter;
+            if (hinted) hinter = std::make_unique<ReadaheadHinter>(folderPath, names);
+            std::string content;
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                if (hinter) hinter->consumed(i);
+                reader.read(names[i], content, nullptr);
+            }
+            hinter.reset();
+            return millisecondsSince(start);
+        };
+        auto range = [&](bool cold, const std::vector<std::string>& names, bool hinted) {
+            double low = 0.0;
+            double high = 0.0;
+            for (int run = 0; run < 5; ++run) {
+                if (cold) {
+                    dropPages();
+                } else {
+                    readAll(names, false);
+                }
+                double ms = readAll(names, hinted);
+                low = run == 0 ? ms : std::min(low, ms);
+                high = std::max(high, ms);
+            }
+            std::ostringstream text;
+            text << low << "-" << high;
+            return text.str();
+        };
+        std::cout << size << "  " << range(false, inodeOrder, false) << "  " << range(false, inodeOrder, true) << "  "
+                  << range(true, directoryOrder, false) << "  " << range(true, inodeOrder, false) << "  "
+                  << range(true, inodeOrder, true) << '\n';
     }
-    if (includeDescription) {
-        std::cout << "  description: " << (data.description.empty() ? "(not found)" : data.description) << std::endl;
+    std::error_code ec;
+    fs::remove_all(base, ec);
+}
+#endif
+
+// The single-lock tracker the striped one replaced, for comparison.
+class LockedNameSet {
+public:
+    bool insertSeen(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !names_.insert(key).second;
     }
 
-    return data;
+private:
+    std::mutex mutex_;
+    std::set<std::string> names_;
+};
+
+// `items` share-code-like keys, every tenth a repeat of an earlier one, inserted from `threads`
+// threads. Returns millions of inserts per second; the duplicate count must come out exact.
+template <typename Insert>
+static double dedupThroughput(const std::vector<std::string>& keys, std::size_t expectedDuplicates,
+                              std::size_t threads, Insert insert) {
+    std::atomic<std::size_t> duplicates{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::size_t seen = 0;
+            for (std::size_t i = t; i < keys.size(); i += threads) {
+                if (insert(keys[i])) ++seen;
+            }
+            duplicates.fetch_add(seen);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = millisecondsSince(start) / 1000.0;
+    if (duplicates.load() != expectedDuplicates) {
+        std::cout << "  [ERROR] counted " << duplicates.load() << " duplicates, expected " << expectedDuplicates << '\n';
+    }
+    return seconds > 0.0 ? keys.size() / seconds / 1e6 : 0.0;
 }
 
-static void writeResultsToFile(const std::vector<PlaylistData>& results, const std::string& outputFile, bool includeAuthor, bool includeDescription) {
-    std::ofstream out(outputFile);
-    if (!out) {
-        std::cerr << "Failed to open output file: " << outputFile << std::endl;
-        return;
+// `items` file-size-like values recorded from `threads` threads, either each into its own
+// thread's histogram or all into one behind a mutex. Returns wall-clock nanoseconds per sample,
+// value generation included; the merged count must come out exact.
+static double histogramCost(std::size_t threads, std::size_t items, bool shared) {
+    LogHistogram sharedHistogram;
+    std::mutex sharedMutex;
+    HistogramRegistry::collect();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            LogHistogram& own = HistogramRegistry::local().fileBytes;
+            for (std::size_t i = t; i < items; i += threads) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                std::uint64_t value = 512 + (x & 0xFFFF);
+                if (shared) {
+                    std::lock_guard<std::mutex> lock(sharedMutex);
+                    sharedHistogram.record(value);
+                } else {
+                    own.record(value);
+                }
+            }
+        });
     }
+    for (auto& worker : workers) worker.join();
+    double nanos = millisecondsSince(start) * 1e6;
+    std::uint64_t recorded = shared ? sharedHistogram.count() : HistogramRegistry::collect().fileBytes.count();
+    if (recorded != items) {
+        std::cout << "  [ERROR] recorded " << recorded << " samples, expected " << items << '\n';
+    }
+    return nanos / static_cast<double>(items);
+}
 
-    for (const auto& result : results) {
-        out << "Playlist Name: " << (result.playlistName.empty() ? "(not found)" : result.playlistName) << std::endl;
-        out << "Share Code: " << (result.shareCode.empty() ? "(not found)" : result.shareCode) << std::endl;
-        if (includeAuthor && !result.authorName.empty() && !result.authorSteamId.empty()) {
-            out << "Author: " << result.authorName << " SID: " << result.authorSteamId << std::endl;
+// Usage: parsejson --bench queue [--items N] [--max-threads T]
+//        parsejson --bench dedup [--items N] [--max-threads T]
+//        parsejson --bench histogram [--items N] [--max-threads T]
+//        parsejson --bench trace [--items N]
+//        parsejson --bench format [--items N] [--max-threads T]
+//        parsejson --bench ostream [--items N]
+//        parsejson --bench lsh [--items N]
+//        parsejson --bench roots [--files-per-root F] [--max-threads R]
+//        parsejson --bench scenarios [--items N]   (N playlists, default 100000)
+//        parsejson --bench startup [--runs R] [--baseline OLD_EXE]
+//        parsejson --bench enumerate [--items N]   (N directory entries, default 1000000)
+//        parsejson --bench deep [--items N]   (N files, default 20000)
+//        parsejson --bench cache [--items N]   (N files, default 2000)
+//        parsejson --bench readahead [--items N]   (300 and N files, default 5000; Linux)
+//        parsejson --bench scaling FOLDER [--max-threads T]
+static int runBenchmarks(const std::string& program, int argc, char* argv[]) {
+    std::string which = argc > 1 ? argv[1] : "";
+    std::size_t items = 2000000;
+    bool itemsGiven = false;
+    std::size_t maxThreads = 64;
+    std::size_t filesPerRoot = 2000;
+    std::size_t runs = 10;
+    std::string baseline;
+    std::string folderPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--items" && i + 1 < argc) {
+            items = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+            itemsGiven = true;
+        } else if (arg == "--max-threads" && i + 1 < argc) {
+            maxThreads = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--files-per-root" && i + 1 < argc) {
+            filesPerRoot = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--runs" && i + 1 < argc) {
+            runs = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (which == "scaling" && folderPath.empty() && fs::is_directory(arg)) {
+            folderPath = arg;
+        } else {
+            std::cerr << "Error: Unknown argument: " << arg << std::endl;
+            return 1;
         }
-        if (includeDescription && !result.description.empty()) {
-            out << "Description: " << result.description << std::endl;
+    }
+
+    if (which == "queue") {
+        std::cout << "=== QUEUE THROUGHPUT (Mitems/s, " << items << " items, "
+                  << std::thread::hardware_concurrency() << " hardware threads) ===" << '\n';
+        std::cout << "threads  mutex/batch16  ring/batch1  ring/batch16" << '\n';
+        for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            MutexQueue<std::uint32_t> mutexQueue;
+            MpmcRing<std::uint32_t> ring(1024);
+            MpmcRing<std::uint32_t> batchedRing(1024);
+            double viaMutex = queueThroughput(mutexQueue, threads, 16, items);
+            double viaRing = queueThroughput(ring, threads, 1, items);
+            double viaBatches = queueThroughput(batchedRing, threads, 16, items);
+            std::cout << threads << "  " << viaMutex << "  " << viaRing << "  " << viaBatches << '\n';
+        }
+        return 0;
+    }
+    if (which == "dedup") {
+        std::vector<std::string> keys;
+        std::mt19937_64 random(1);
+        std::size_t expectedDuplicates = 0;
+        for (std::size_t i = 0; i < items; ++i) {
+            if (i % 10 == 9) {
+                keys.push_back(keys[random() % keys.size()]);
+                ++expectedDuplicates;
+            } else {
+                keys.push_back("KovaaKsCode" + std::to_string(random()));
+            }
+        }
+        std::cout << "=== DEDUP INSERTS (Minserts/s, " << items << " keys, 10% duplicates, "
+                  << std::thread::hardware_concurrency() << " hardware threads) ===" << '\n';
+        std::cout << "threads  one-lock set  striped map" << '\n';
+        for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            LockedNameSet locked;
+            StripedHashMap<int> striped;
+            double viaLock = dedupThroughput(keys, expectedDuplicates, threads,
+                                             [&locked](const std::string& key) { return locked.insertSeen(key); });
+            double viaStripes = dedupThroughput(keys, expectedDuplicates, threads, [&striped](const std::string& key) {
+                return striped.withValue(key, [](int& copies) { return ++copies > 1; });
+            });
+            std::cout << threads << "  " << viaLock << "  " << viaStripes << '\n';
+        }
+        return 0;
+    }
+    if (which == "histogram") {
+        // Quantiles are bucket bounds, so they may be off by up to one sub-bucket (12.5%).
+        std::vector<std::uint64_t> values;
+        LogHistogram histogram;
+        std::mt19937_64 random(1);
+        for (std::size_t i = 0; i < 100000; ++i) {
+            values.push_back(random() % (1u << (random() % 24)));
+            histogram.record(values.back());
+        }
+        std::sort(values.begin(), values.end());
+        for (double q : {0.5, 0.9, 0.99}) {
+            std::uint64_t exact = values[static_cast<std::size_t>(q * (values.size() - 1))];
+            std::uint64_t estimate = histogram.quantile(q);
+            if (estimate < exact || estimate > exact + exact / 8 + 1) {
+                std::cout << "  [ERROR] q" << q << ": " << estimate << ", exact " << exact << '\n';
+            }
+        }
+        std::cout << "=== HISTOGRAM RECORDING (ns/sample, " << items << " samples, "
+                  << std::thread::hardware_concurrency() << " hardware threads) ===" << '\n';
+        std::cout << "threads  per-thread  one-mutex" << '\n';
+        for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            double own = histogramCost(threads, items, false);
+            double shared = histogramCost(threads, items, true);
+            std::cout << threads << "  " << own << "  " << shared << '\n';
+        }
+        return 0;
+    }
+    if (which == "trace") {
+        // Spans with tracing off and on; a scan records about four per file.
+        std::cout << "=== TRACE SPANS (ns/span, " << items << " spans) ===" << '\n';
+        for (bool enabled : {false, true}) {
+            traceEnabled = enabled;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < items; ++i) {
+                TraceSpan span("bench");
+                span.setBytes(i);
+            }
+            double nanos = millisecondsSince(start) * 1e6;
+            std::cout << (enabled ? "on   " : "off  ") << nanos / static_cast<double>(items) << '\n';
+        }
+        traceEnabled = false;
+        return 0;
+    }
+    if (which == "format") {
+        // The default layout with author and description, formatted as for results.txt; writing is not timed.
+        std::vector<PlaylistData> results = syntheticResults(items);
+        ScanOptions options;
+        options.includeAuthor = true;
+        options.includeDescription = true;
+        std::cout << "=== RESULT FORMATTING (Mrecords/s, " << items << " records, "
+                  << std::thread::hardware_concurrency() << " hardware threads) ===" << '\n';
+        std::cout << "threads  default layout, -a -d" << '\n';
+        for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::string> chunks = formatChunks(results, options, threads);
+            double seconds = millisecondsSince(start) / 1000.0;
+            std::cout << threads << "  " << (seconds > 0.0 ? items / seconds / 1e6 : 0.0) << '\n';
         }
-        out << std::endl;
+        return 0;
     }
+    if (which == "ostream") {
+        // One thread, default layout with author and description, so only the formatting method differs.
+        std::vector<PlaylistData> results = syntheticResults(items);
+        ScanOptions options;
+        options.includeAuthor = true;
+        options.includeDescription = true;
+        std::cout << "=== TEXT FORMATTING (ms, " << items << " records, one thread) ===" << '\n';
 
-    out.close();
-    std::cout << "Results written to " << outputFile << std::endl;
+        fs::path scratch = fs::temp_directory_path() / "parsejson_bench_ostream.txt";
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::ofstream file(scratch);
+            formatWithOstream(file, results, true);
+        }
+        std::cout << "ofstream, std::endl per line  " << millisecondsSince(start) << '\n';
+        std::error_code ec;
+        fs::remove(scratch, ec);
+
+        start = std::chrono::steady_clock::now();
+        std::ostringstream stream;
+        formatWithOstream(stream, results, false);
+        std::string viaStream = stream.str();
+        std::cout << "ostringstream, '\\n'           " << millisecondsSince(start) << '\n';
+
+        start = std::chrono::steady_clock::now();
+        std::string viaBuffer;
+        formatResults(results, 0, results.size(), options, viaBuffer);
+        std::cout << "direct buffer appends         " << millisecondsSince(start) << '\n';
+
+        if (viaStream != viaBuffer) {
+            std::cout << "  [ERROR] buffer output differs from the ostringstream output" << '\n';
+            return 1;
+        }
+        return 0;
+    }
+    if (which == "lsh") {
+        // The --similar path: index build over every signature, then single queries (candidates,
+        // scoring and sort) for records picked at random.
+        constexpr std::size_t kQueries = 1000;
+        std::vector<PlaylistData> results = syntheticSignatures(items);
+        std::cout << "=== SIMILARITY INDEX (" << items << " signatures, " << kMinHashSize << " hashes in "
+                  << kLshBands << " bands) ===" << '\n';
+        auto start = std::chrono::steady_clock::now();
+        LshIndex index;
+        index.build(results);
+        std::cout << "index build  " << millisecondsSince(start) << " ms" << '\n';
+
+        std::mt19937_64 random(2);
+        std::vector<double> latencies;
+        std::size_t candidates = 0;
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            const PlaylistData& target = results[random() % results.size()];
+            auto queryStart = std::chrono::steady_clock::now();
+            candidates += rankSimilar(index, results, target.minHash).size();
+            latencies.push_back(millisecondsSince(queryStart) * 1000.0);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "query        p50 " << latencies[kQueries / 2] << " us, p99 " << latencies[kQueries * 99 / 100]
+                  << " us, max " << latencies.back() << " us, " << candidates / kQueries << " candidates on average"
+                  << '\n';
+        return 0;
+    }
+    if (which == "roots") {
+        rootScaling(std::max<std::size_t>(1, std::min<std::size_t>(maxThreads, 8)), std::max<std::size_t>(1, filesPerRoot));
+        return 0;
+    }
+    if (which == "scenarios") {
+        scenarioStatsCost(std::max<std::size_t>(1, itemsGiven ? items : 100000));
+        return 0;
+    }
+    if (which == "startup") {
+        startupCost(program, baseline, std::max<std::size_t>(1, runs));
+        return 0;
+    }
+    if (which == "enumerate") {
+        enumerationCost(std::max<std::size_t>(1, itemsGiven ? items : 1000000));
+        return 0;
+    }
+    if (which == "deep") {
+        deepPathCost(std::max<std::size_t>(1, itemsGiven ? items : 20000));
+        return 0;
+    }
+    if (which == "cache") {
+        cacheCost(std::max<std::size_t>(1, itemsGiven ? items : 2000));
+        return 0;
+    }
+    if (which == "readahead") {
+#if defined(HAVE_FADVISE)
+        readaheadCost(std::max<std::size_t>(1, itemsGiven ? items : 5000));
+        return 0;
+#else
+        std::cerr << "Error: --bench readahead needs posix_fadvise (Linux, without JSON_PARSER_NO_FADVISE)" << std::endl;
+        return 1;
+#endif
+    }
+    if (which == "scaling" && !folderPath.empty()) {
+        scalingCurve(folderPath, std::max<std::size_t>(1, maxThreads));
+        return 0;
+    }
+    std::cerr << "Error: --bench expects queue, dedup, histogram, trace, format, ostream, lsh, roots, scenarios, startup, "
+                 "enumerate, deep, cache, readahead or scaling FOLDER"
+              << std::endl;
+    return 1;
 }
+#endif
 
+#if !defined(JSON_PARSER_FUZZ)
 int main(int argc, char* argv[]) {
-    bool includeAuthor = false;
-    bool includeDescription = false;
-    bool skipStats = false;
-    std::string folderPath = ".";
+    // Console output is only ever written through iostreams, so the C stdio sync is pure overhead.
+    std::ios::sync_with_stdio(false);
+    double mainEntryMs = millisecondsSince(processStart);
+
+#if defined(JSON_PARSER_DIFFTEST)
+    if (argc > 1 && std::string(argv[1]) == "--difftest") {
+        return runDifferentialTest(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks(argv[0], argc - 1, argv + 1);
+    }
+#endif
+
+    // "merge" takes shard files instead of folders; every other option means the same.
+    bool mergeMode = argc > 1 && std::string(argv[1]) == "merge";
+
+    ScanOptions options;
+    std::vector<std::string> folderPaths;
     std::string outputPath = "";
     std::string outputFilename = "results.txt";
+    std::string templateText;
+    bool haveTemplate = false;
+    bool stdinMode = false;
+    std::string traceFile;
+    JsonStreamSplitter::Framing stdinFraming = JsonStreamSplitter::Framing::Auto;
 
     // Parse arguments
-    for (int i = 1; i < argc; ++i) {
+    for (int i = mergeMode ? 2 : 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "-a" || arg == "--author") {
-            includeAuthor = true;
+            options.includeAuthor = true;
         } else if (arg == "-d" || arg == "--description") {
-            includeDescription = true;
+            options.includeDescription = true;
         } else if (arg == "-q" || arg == "--quiet") {
-            skipStats = true;
+            options.skipStats = true;
+        } else if (arg == "-c" || arg == "--canonicalize") {
+            options.canonicalize = true;
+        } else if (arg == "--scenario-stats") {
+            options.scenarioStats = true;
+        } else if (arg == "--similar") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --similar requires a share code" << std::endl;
+                return 1;
+            }
+            options.similarTo = argv[++i];
+        } else if (arg == "-w" || arg == "--watch") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                std::cerr << "Error: -w/--watch requires an interval in seconds" << std::endl;
+                return 1;
+            }
+            options.watchSeconds = std::atoi(argv[++i]);
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                std::cerr << "Error: -j/--jobs requires a thread count" << std::endl;
+                return 1;
+            }
+            options.jobs = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--pin") {
+            options.pinThreads = true;
+        } else if (arg == "--dir-order") {
+            options.directoryOrder = true;
+        } else if (arg == "--cache-mb") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --cache-mb requires a size in megabytes" << std::endl;
+                return 1;
+            }
+            options.cacheBudgetBytes = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10)) * 1024 * 1024;
+        } else if (arg == "-f" || arg == "--fields") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: -f/--fields requires a comma-separated list of field names" << std::endl;
+                return 1;
+            }
+            std::stringstream list(argv[++i]);
+            std::string name;
+            while (std::getline(list, name, ',')) {
+                if (!name.empty()) options.fieldNames.push_back(name);
+            }
+            if (options.fieldNames.empty()) {
+                std::cerr << "Error: -f/--fields requires at least one field name" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--template") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --template requires a format string such as \"{shareCode}\\t{playlistName}\\n\"" << std::endl;
+                return 1;
+            }
+            templateText = argv[++i];
+            haveTemplate = true;
+        } else if (arg == "--catalog") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --catalog requires a directory path" << std::endl;
+                return 1;
+            }
+            options.catalogDir = argv[++i];
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --trace requires an output file" << std::endl;
+                return 1;
+            }
+            traceFile = argv[++i];
+        } else if (arg == "--stdin") {
+            stdinMode = true;
+        } else if (arg == "--stdin-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format == "auto") {
+                stdinFraming = JsonStreamSplitter::Framing::Auto;
+            } else if (format == "json") {
+                stdinFraming = JsonStreamSplitter::Framing::Concatenated;
+            } else if (format == "ndjson") {
+                stdinFraming = JsonStreamSplitter::Framing::Lines;
+            } else if (format == "length") {
+                stdinFraming = JsonStreamSplitter::Framing::LengthPrefixed;
+            } else {
+                std::cerr << "Error: --stdin-format requires auto, json, ndjson or length" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--emit-json") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --emit-json requires a directory path" << std::endl;
+                return 1;
+            }
+            options.emitJsonDir = argv[++i];
+        } else if (arg == "--catalog-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format != "html" && format != "md") {
+                std::cerr << "Error: --catalog-format requires html or md" << std::endl;
+                return 1;
+            }
+            options.catalogMarkdown = format == "md";
+        } else if (arg == "--page-size") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                std::cerr << "Error: --page-size requires a number greater than zero" << std::endl;
+                return 1;
+            }
+            options.catalogPageSize = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--shard") {
+            unsigned long index = 0;
+            unsigned long count = 0;
+            char* slash = nullptr;
+            if (i + 1 < argc) {
+                index = std::strtoul(argv[i + 1], &slash, 10);
+                if (*slash == '/') count = std::strtoul(slash + 1, nullptr, 10);
+            }
+            if (count == 0 || index == 0 || index > count) {
+                std::cerr << "Error: --shard requires i/N with 1 <= i <= N" << std::endl;
+                return 1;
+            }
+            ++i;
+            options.shardIndex = index - 1;
+            options.shardCount = count;
+        } else if (arg == "--top") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --top requires a number" << std::endl;
+                return 1;
+            }
+            options.topK = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+            if (options.topK == 0) {
+                std::cerr << "Error: --top requires a number greater than zero" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--policy") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: --policy requires newest, description or scenarios" << std::endl;
+                return 1;
+            }
+            std::string policy = argv[++i];
+            if (policy == "newest") {
+                options.canonicalPolicy = CanonicalPolicy::Newest;
+            } else if (policy == "description") {
+                options.canonicalPolicy = CanonicalPolicy::LongestDescription;
+            } else if (policy == "scenarios") {
+                options.canonicalPolicy = CanonicalPolicy::MostScenarios;
+            } else {
+                std::cerr << "Error: Unknown policy: " << policy << " (expected newest, description or scenarios)" << std::endl;
+                return 1;
+            }
         } else if (arg == "-o" || arg == "--output") {
             if (i + 1 < argc) {
                 outputPath = argv[++i];
@@ -160,18 +5595,94 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         } else {
-            folderPath = arg;
+            folderPaths.push_back(arg);
         }
     }
 
-    if (!fs::exists(folderPath)) {
-        std::cerr << "Error: Path does not exist: " << folderPath << std::endl;
-        return 1;
+    if (mergeMode) {
+        if (folderPaths.empty()) {
+            std::cerr << "Error: merge requires at least one shard file" << std::endl;
+            return 1;
+        }
+        if (options.sharded() || options.watchSeconds > 0) {
+            std::cerr << "Error: --shard and --watch do not apply to merge" << std::endl;
+            return 1;
+        }
     }
 
-    if (!fs::is_directory(folderPath)) {
-        std::cerr << "Error: Path is not a directory: " << folderPath << std::endl;
-        return 1;
+    traceEnabled = !traceFile.empty();
+    nameTraceThread("main");
+    // In watch mode the file is rewritten after every cycle with that cycle's spans.
+    auto writeTrace = [&traceFile](std::ostream& log) {
+        if (traceFile.empty()) return;
+        std::size_t events = 0;
+        std::uint64_t dropped = 0;
+        if (!TraceLog::write(traceFile, events, dropped)) {
+            std::cerr << "Failed to write trace file: " << traceFile << std::endl;
+            return;
+        }
+        log << "Trace written to " << traceFile << " (" << events << " spans";
+        if (dropped > 0) log << ", " << dropped << " older spans overwritten";
+        log << ")" << '\n';
+    };
+
+    if (folderPaths.empty() && !stdinMode) {
+        folderPaths.push_back(".");
+    }
+
+    if (haveTemplate) {
+        if (!options.fieldNames.empty()) {
+            std::cerr << "Error: --template and -f/--fields cannot be combined" << std::endl;
+            return 1;
+        }
+        std::string error;
+        if (!compileTemplate(templateText, options.templateOps, options.fieldNames, error)) {
+            std::cerr << "Error: Invalid --template: " << error << std::endl;
+            return 1;
+        }
+        if (options.templateOps.empty()) {
+            std::cerr << "Error: --template must not be empty" << std::endl;
+            return 1;
+        }
+        // A template without placeholders still needs the fields that make a record valid.
+        if (options.fieldNames.empty()) options.fieldNames.push_back("shareCode");
+    }
+
+    if (!options.fieldNames.empty()) {
+        // The canonical policies, the catalog and --emit-json use values that -f may not select.
+        bool needDescription = (options.canonicalize && options.canonicalPolicy == CanonicalPolicy::LongestDescription) ||
+                               !options.emitJsonDir.empty();
+        bool needScenarioCount = (options.canonicalize && options.canonicalPolicy == CanonicalPolicy::MostScenarios) ||
+                                 !options.catalogDir.empty();
+        bool needAuthor = !options.catalogDir.empty() || !options.emitJsonDir.empty();
+        options.fieldTable = FieldTable::compile(options.fieldNames, needDescription, needScenarioCount, needAuthor);
+    }
+
+    if (stdinMode) {
+        if (mergeMode || !folderPaths.empty() || options.canonicalize || options.sharded() || options.watchSeconds > 0 ||
+            options.scenarioStats || !options.similarTo.empty() || !options.catalogDir.empty() ||
+            !options.emitJsonDir.empty()) {
+            std::cerr << "Error: --stdin takes no folders and works record by record; it cannot be combined with "
+                         "merge, -c, --shard, --watch, --scenario-stats, --similar, --catalog or --emit-json"
+                      << std::endl;
+            return 1;
+        }
+        int status = runStdin(options, stdinFraming);
+        writeTrace(std::cerr);
+        return status;
+    }
+
+    for (const auto& folderPath : folderPaths) {
+        if (!fs::exists(folderPath)) {
+            std::cerr << "Error: Path does not exist: " << folderPath << std::endl;
+            return 1;
+        }
+
+        if (mergeMode) continue;
+        if (!fs::is_directory(folderPath)) {
+            std::cerr << "Error: Path is not a directory: " << folderPath << std::endl;
+            return 1;
+        }
     }
 
     // Validate output path if provided
@@ -186,74 +5697,41 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    std::cout << "Scanning folder: " << folderPath << std::endl;
-    std::cout << std::endl;
-
-    std::vector<PlaylistData> results;
-    std::set<std::string> seenShareCodes;
-    std::set<std::string> seenPlaylistNames;
-    int fileCount = 0;
-    int successfulParses = 0;
-    int failedParses = 0;
-    int duplicateShareCodes = 0;
-    int duplicateNames = 0;
-
-    for (const auto& entry : fs::directory_iterator(folderPath)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".json") {
-            ++fileCount;
-            PlaylistData data = parseJsonFile(entry.path().string(), includeAuthor, includeDescription);
-            
-            if (!data.playlistName.empty() && !data.shareCode.empty()) {
-                ++successfulParses;
-                
-                // Check for duplicate share codes
-                if (seenShareCodes.count(data.shareCode)) {
-                    ++duplicateShareCodes;
-                    std::cout << "  [WARNING] Duplicate share code detected: " << data.shareCode << std::endl;
-                } else {
-                    seenShareCodes.insert(data.shareCode);
-                }
-                
-                // Check for duplicate playlist names
-                if (seenPlaylistNames.count(data.playlistName)) {
-                    ++duplicateNames;
-                    std::cout << "  [WARNING] Duplicate playlist name detected: " << data.playlistName << std::endl;
-                } else {
-                    seenPlaylistNames.insert(data.playlistName);
-                }
-                
-                results.push_back(data);
-            } else {
-                ++failedParses;
-            }
-        }
+    // Shards write "<name>.shard-<i>-of-<N>.bin" beside where the text results would go;
+    // a merge writes next to its first shard file.
+    if (options.sharded()) {
+        outputFilename = fs::path(outputFilename).stem().string() + ".shard-" + std::to_string(options.shardIndex + 1) +
+                         "-of-" + std::to_string(options.shardCount) + ".bin";
+    }
+    std::string outputFile;
+    if (!outputPath.empty()) {
+        outputFile = (fs::path(outputPath) / outputFilename).string();
+    } else {
+        outputFile = (fs::path(folderPaths[0]).parent_path() / outputFilename).string();
     }
 
-    if (!skipStats) {
-        std::cout << std::endl;
-        std::cout << "=== STATISTICS ===" << std::endl;
-        std::cout << "Total files processed: " << fileCount << std::endl;
-        std::cout << "Successful parses: " << successfulParses << std::endl;
-        std::cout << "Failed parses: " << failedParses << std::endl;
-        std::cout << "Duplicate share codes: " << duplicateShareCodes << std::endl;
-        std::cout << "Duplicate playlist names: " << duplicateNames << std::endl;
-        std::cout << "==================" << std::endl;
+    if (mergeMode) {
+        int status = runMerge(folderPaths, options, outputFile);
+        writeTrace(std::cout);
+        return status;
     }
 
-    if (fileCount == 0) {
-        std::cout << "\nNo .json files found in the directory." << std::endl;
-    } else if (successfulParses > 0) {
-        std::cout << std::endl;
-        std::string outputFile;
-        if (!outputPath.empty()) {
-            outputFile = (fs::path(outputPath) / outputFilename).string();
-        } else {
-            outputFile = (fs::path(folderPath).parent_path() / outputFilename).string();
-        }
-        writeResultsToFile(results, outputFile, includeAuthor, includeDescription);
-    } else {
-        std::cout << "\nNo valid results to write." << std::endl;
+    if (options.watchSeconds <= 0) {
+        runScan(folderPaths, options, outputFile, nullptr, mainEntryMs);
+        writeTrace(std::cout);
+        return 0;
     }
 
+    // Watch mode: rescan forever; files whose bytes have not changed come out of the cache.
+    ParseCache cache;
+    cache.budgetBytes = options.cacheBudgetBytes;
+    for (int cycle = 1;; ++cycle) {
+        std::cout << "=== WATCH CYCLE " << cycle << " ===" << '\n';
+        runScan(folderPaths, options, outputFile, &cache, cycle == 1 ? mainEntryMs : -1.0);
+        writeTrace(std::cout);
+        std::cout << std::flush;
+        std::this_thread::sleep_for(std::chrono::seconds(options.watchSeconds));
+    }
     return 0;
 }
+#endif